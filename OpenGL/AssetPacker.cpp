@@ -0,0 +1,97 @@
+// Empaqueta los recursos del juego en un solo archivo (ver learnopengl/asset_pack.h).
+// Se ejecuta desde la carpeta OpenGL, donde el juego busca sus recursos:
+//     AssetPacker                      -> assets.pack con model, textures, shaders y audio
+//     AssetPacker salida.pack dir...   -> otro nombre y otras carpetas
+// Las cachés que genera el juego (.meshcache, .dds junto a las imágenes) no se incluyen:
+// se siguen escribiendo y leyendo como archivos sueltos.
+
+#include <learnopengl/asset_pack.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+static bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// archivos derivados que el juego regenera: la caché de mallas y los .dds de las texturas comprimidas
+static bool isCacheFile(const std::string& name) {
+    std::string lower = AssetPack::Key(name);
+    if (endsWith(lower, ".meshcache")) return true;
+    if (!endsWith(lower, ".dds")) return false;
+    std::string stem = lower.substr(0, lower.size() - 4);
+    return stem.find('.', stem.find_last_of('/') + 1) != std::string::npos;
+}
+
+// agrega recursivamente los archivos de 'dir' a 'files'
+static void collectFiles(const std::string& dir, std::vector<AssetPackSource>& files) {
+    std::vector<std::string> names, subdirs;
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((dir + "/*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE) return;
+    do {
+        std::string name = data.cFileName;
+        if (name == "." || name == "..") continue;
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) subdirs.push_back(name);
+        else names.push_back(name);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR* handle = opendir(dir.c_str());
+    if (!handle) return;
+    while (dirent* entry = readdir(handle)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+        struct stat info;
+        if (stat((dir + "/" + name).c_str(), &info) != 0) continue;
+        if (S_ISDIR(info.st_mode)) subdirs.push_back(name);
+        else names.push_back(name);
+    }
+    closedir(handle);
+#endif
+    for (const std::string& name : names) {
+        std::string path = dir + "/" + name;
+        if (isCacheFile(path)) continue;
+        AssetPackSource source;
+        source.name = path;
+        source.path = path;
+        files.push_back(source);
+    }
+    for (const std::string& name : subdirs)
+        collectFiles(dir + "/" + name, files);
+}
+
+int main(int argc, char** argv) {
+    std::string output = argc > 1 ? argv[1] : "assets.pack";
+    std::vector<std::string> dirs;
+    for (int i = 2; i < argc; i++) dirs.push_back(argv[i]);
+    if (dirs.empty()) dirs = { "model", "textures", "shaders", "audio" };
+
+    std::vector<AssetPackSource> files;
+    for (const std::string& dir : dirs) collectFiles(dir, files);
+    if (files.empty()) {
+        std::cout << "No se encontraron archivos para empaquetar" << std::endl;
+        return 1;
+    }
+
+    uint64_t bytes = 0;
+    for (const AssetPackSource& file : files) {
+        FileStamp stamp;
+        if (GetFileStamp(file.path, stamp)) bytes += stamp.size;
+    }
+    if (!AssetPack::Write(output, files)) {
+        std::cout << "No se pudo escribir " << output << std::endl;
+        return 1;
+    }
+    std::cout << output << ": " << files.size() << " archivos, " << bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    return 0;
+}
@@ -8,6 +8,7 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/model_registry.h>
 
 #include <iostream>
 
@@ -87,7 +88,7 @@ int main()
     // -----------
     //Model ourModel(FileSystem::getPath("resources/objects/backpack/backpack.obj"));
     //Model ourModel("D:/LEONARDO/VisualStudio/OpenGL/OpenGL/model/backpack/backpack.obj");
-    Model ourModel("model/calavera/calavera.obj");
+    ModelHandle ourModel = ModelRegistry::Instance().Load("model/calavera/calavera.obj");
     
     
     // draw in wireframe
@@ -134,7 +135,7 @@ int main()
         model = glm::scale(model, glm::vec3(3.0f));
 
         ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
+        ourModel->Draw(ourShader);
 
         // render the loaded model
         /*
@@ -142,7 +143,7 @@ int main()
         model = glm::translate(model, glm::vec3(0.0f, 0.0f, -50.0f)); // translate it down so it's at the center of the scene
         model = glm::scale(model, glm::vec3(3.0f, 3.0f, 3.0f));	// it's a bit too big for our scene, so scale it down
         ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
+        ourModel->Draw(ourShader);
         */
 
 
@@ -154,6 +155,9 @@ int main()
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
+    // free the model while the context still exists
+    ourModel.reset();
+    ModelRegistry::Instance().clear();
     glfwTerminate();
     return 0;
 }
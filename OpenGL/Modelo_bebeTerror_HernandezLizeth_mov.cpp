@@ -8,6 +8,7 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/model_registry.h>
 
 #include <iostream>
 
@@ -88,7 +89,7 @@ int main()
     //Model ourModel(FileSystem::getPath("resources/objects/backpack/backpack.obj"));
     //Model ourModel("C:/Users/User/OneDrive - Escuela Politcnica Nacional/Documentos/Visual Studio 2022/OpenGL/OpenGL/model/backpack/backpack.obj");
     //Model ourModel("model/helicopter/helicopter.obj");
-    Model ourModel("model/terrorNurse/terrorNurse.obj");
+    ModelHandle ourModel = ModelRegistry::Instance().Load("model/terrorNurse/terrorNurse.obj");
     
     
     // draw in wireframe
@@ -132,7 +133,7 @@ int main()
         model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
 
         ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
+        ourModel->Draw(ourShader);
 
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -143,6 +144,9 @@ int main()
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
+    // free the model while the context still exists
+    ourModel.reset();
+    ModelRegistry::Instance().clear();
     glfwTerminate();
     return 0;
 }
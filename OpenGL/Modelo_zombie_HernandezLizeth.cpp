@@ -8,6 +8,7 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/model_registry.h>
 
 #include <iostream>
 
@@ -87,7 +88,7 @@ int main()
     // -----------
     //Model ourModel(FileSystem::getPath("resources/objects/backpack/backpack.obj"));
     //Model ourModel("D:/LEONARDO/VisualStudio/OpenGL/OpenGL/model/backpack/backpack.obj");
-    Model ourModel("model/zombie/zombie.obj");
+    ModelHandle ourModel = ModelRegistry::Instance().Load("model/zombie/zombie.obj");
     
     
     // draw in wireframe
@@ -140,7 +141,7 @@ int main()
         model = glm::scale(model, glm::vec3(0.1f));
 
         ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
+        ourModel->Draw(ourShader);
 
 
 
@@ -149,7 +150,7 @@ int main()
         model = glm::translate(model, glm::vec3(0.0f, -10.0f, -20.0f)); // translate it down so it's at the center of the scene
         model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));	// it's a bit too big for our scene, so scale it down
         ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
+        ourModel->Draw(ourShader);
         */
 
 
@@ -161,6 +162,9 @@ int main()
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
+    // free the model while the context still exists
+    ourModel.reset();
+    ModelRegistry::Instance().clear();
     glfwTerminate();
     return 0;
 }
@@ -8,6 +8,13 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/asset_loader.h>
+#include <learnopengl/model_registry.h>
+#include <learnopengl/model_streamer.h>
+#include <learnopengl/load_profiler.h>
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/light_buffer.h>
+#include <learnopengl/render_queue.h>
 
 #include <iostream>
 #include <vector>
@@ -22,6 +29,8 @@
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <learnopengl/stb_image.h>
+#define ALLOCATION_COUNTER_IMPLEMENTATION
+#include <learnopengl/allocation_counter.h>
 
 #define SDL_MAIN_HANDLED
 #include <SDL2/SDL.h>
@@ -36,7 +45,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-unsigned int loadCubemap(std::vector<std::string> faces);
+Mix_Chunk* loadSound(const char* path);
+Mix_Music* loadMusic(const char* path);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 
 // Configuraciones Globales
@@ -45,6 +55,11 @@ const unsigned int SCR_HEIGHT = 720;
 const float GROUND_HEIGHT = 0.0f;
 const float EYE_HEIGHT = -0.75f;
 
+// Paquete de recursos (generado con AssetPacker); sin él se leen los archivos sueltos
+const char* ASSET_PACK_PATH = "assets.pack";
+// Hashes del contenido de las texturas, para no volver a leerlas en cada inicio
+const char* TEXTURE_HASHES_PATH = "texture_hashes.cache";
+
 // Estado del Jugador
 bool flashlightOn = false; // Ahora apagada al inicio
 bool leftMousePressed = false;
@@ -73,14 +88,14 @@ int ambientCurrentVolume = 40;
 // Screamer
 bool screamerTriggered = false;
 float gameTime = 0.0f;
-Model* screamerModel = nullptr;
+ModelHandle screamerModel;
 float screamerTimer = 0.0f;
 const float SCREAMER_DURATION = 2.0f;
 glm::vec3 screamerOffset = glm::vec3(-0.02f, -0.5f, 0.0f);
 float screamerDistance = 0.5f;
 
 // --- Evento del Ángel Principal ---
-Model* angelModel = nullptr;
+ModelHandle angelModel;
 glm::vec3 angelPos = glm::vec3(14.8837f, -0.5f, 4.18598f);
 glm::vec3 angelTriggerPos = glm::vec3(11.6398f, -0.75f, 3.91526f);
 bool angelEventActive = false;
@@ -88,7 +103,7 @@ bool angelGone = false;
 float angelTimer = 0.0f;
 
 //Screamer 
-Model* currentScreamerModel = nullptr;
+ModelHandle currentScreamerModel;
 glm::vec3 activeScreamerScale = glm::vec3(1.0f);
 float activeScreamerRotation = 0.0f;
 float activeScreamerYOffset = -0.5f;
@@ -302,6 +317,15 @@ enum GameState {
 GameState gameState = LOADING;
 bool showMenu = true;
 float loadingProgress = 0.0f;
+
+// Carga en segundo plano: el hilo de carga importa y decodifica, aquí solo se sube a la GPU
+AssetLoader* assetLoader = nullptr;
+const size_t UPLOAD_BUDGET_PER_FRAME = 8 * 1024 * 1024; // bytes por frame enviados a la GPU durante la carga
+// Ángel, mujer y bebé solo se usan en sus eventos: se cargan al acercarse y se liberan cuando el evento termina
+ModelStreamer* modelStreamer = nullptr;
+const float STREAMING_RADIUS = 20.0f;                       // distancia a un evento a la que empieza la carga
+const size_t STREAMING_MEMORY_BUDGET = 32 * 1024 * 1024;    // memoria de los modelos de eventos antes de liberar los terminados
+const size_t STREAMING_UPLOAD_PER_FRAME = 2 * 1024 * 1024;  // bytes por frame durante el juego, para no dar tirones
 float loadingDotTimer = 0.0f;
 int loadingDotCount = 1;
 
@@ -309,16 +333,133 @@ int loadingDotCount = 1;
 GLFWwindow* gWindow = nullptr;
 
 // Modelos globales
-Model* environment = nullptr;
-Model* itemModel = nullptr;
-Model* lampModel = nullptr;
-Model* mujerModel = nullptr;
+ModelHandle environment;
+ModelHandle itemModel;
+ModelHandle lampModel;
+ModelHandle mujerModel;
+// texturas de los props (lámpara, cassette) agrupadas en arreglos de texturas
+TextureArraySet propTextureArrays;
 Shader* sceneShader = nullptr;
+// scene_instanced.vs + scene.fs: lámparas y cassettes, todas las copias de una malla en una sola llamada
+Shader* sceneInstancedShader = nullptr;
 Shader* skyboxShader = nullptr;
+
+// Uniforms que se fijan en cada cuadro, resueltos una sola vez después de compilar los shaders
+// (sin armar cadenas ni consultar al driver en el bucle de render). Las luces van aparte, en el LightBuffer.
+struct SceneUniforms {
+    Uniform<glm::vec3> fogColor, viewPos;
+    Uniform<glm::mat4> projection, view;
+} sceneUniforms, sceneInstancedUniforms;
+struct RainUniforms {
+    Uniform<glm::mat4> projection, view;
+    Uniform<glm::vec3> spotLightPos, spotLightDir;
+    Uniform<bool> flashlightOn;
+} rainUniforms;
+// Los modelos de la escena no se dibujan al momento: se encolan con su llave de orden y
+// renderQueue.Flush() los dibuja agrupados por estado y de adelante hacia atrás
+RenderQueue renderQueue;
+// Matrices por instancia: las lámparas no se mueven (se suben una vez), los cassettes flotan y
+// giran (se suben cada cuadro, solo los que no se han recogido)
+InstanceBuffer lampInstances;
+InstanceBuffer itemInstances;
+
+struct SkyboxUniforms {
+    Uniform<glm::mat4> projection, view;
+} skyboxUniforms;
+
+void resolveSceneUniforms(Shader* shader, SceneUniforms& s) {
+    s.fogColor = shader->GetUniform<glm::vec3>("fogColor");
+    s.viewPos = shader->GetUniform<glm::vec3>("viewPos");
+    s.projection = shader->GetUniform<glm::mat4>("projection");
+    s.view = shader->GetUniform<glm::mat4>("view");
+}
+
+void resolveShaderUniforms() {
+    resolveSceneUniforms(sceneShader, sceneUniforms);
+    resolveSceneUniforms(sceneInstancedShader, sceneInstancedUniforms);
+
+    rainUniforms.projection = rainShader->GetUniform<glm::mat4>("projection");
+    rainUniforms.view = rainShader->GetUniform<glm::mat4>("view");
+    rainUniforms.spotLightPos = rainShader->GetUniform<glm::vec3>("spotLightPos");
+    rainUniforms.spotLightDir = rainShader->GetUniform<glm::vec3>("spotLightDir");
+    rainUniforms.flashlightOn = rainShader->GetUniform<bool>("flashlightOn");
+
+    skyboxUniforms.projection = skyboxShader->GetUniform<glm::mat4>("projection");
+    skyboxUniforms.view = skyboxShader->GetUniform<glm::mat4>("view");
+}
+
+// Las lámparas no se mueven ni cambian de color: se escriben una vez en el LightBuffer
+// (se suben en el primer Upload) y cualquier shader con los bloques de luces las comparte.
+void setupLampLights() {
+    LightBuffer& lights = LightBuffer::Instance();
+    LightBuffer::Attach(*sceneShader);
+    LightBuffer::Attach(*sceneInstancedShader);
+    unsigned int count = std::min((unsigned int)lamps.size(), MAX_POINT_LIGHTS);
+    for (unsigned int i = 0; i < count; i++) {
+        PointLightStd140 light;
+        light.position = lamps[i].pos + glm::vec3(0.0f, 0.4f, 0.0f);
+        // Luz más intensa, sin parpadeo
+        light.ambient = glm::vec3(0.08f);
+        light.diffuse = glm::vec3(1.0f);
+        light.specular = glm::vec3(0.5f);
+        light.constant = 1.0f;
+        light.linear = 0.22f;     // Rango más corto
+        light.quadratic = 0.08f;  // Más rápido falloff
+        lights.SetPointLight(i, light);
+    }
+    lights.SetPointLightCount(count);
+}
+
+// Matrices de las lámparas, una sola vez: se dibujan con lampInstances
+void setupLampInstances() {
+    std::vector<glm::mat4> matrices;
+    for (const Lamp& lamp : lamps) {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, lamp.pos + glm::vec3(0.0f, 0.75f, 0.0f));
+        model = glm::rotate(model, glm::radians(lamp.rotY), glm::vec3(0, 1, 0));
+        model = glm::translate(model, glm::vec3(0.0f, 0.0f, -0.25f));
+        model = glm::scale(model, glm::vec3(0.4f));
+        matrices.push_back(model);
+    }
+    lampInstances.Upload(matrices);
+}
+
+// La linterna cambia cada cuadro (sigue a la cámara): bloque pequeño aparte
+void updateFlashlight() {
+    SpotLightStd140 spot;
+    spot.position = camera.Position;
+    spot.direction = camera.Front;
+    if (flashlightOn) {
+        spot.ambient = glm::vec3(0.9f, 0.9f, 0.9f);
+        spot.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
+        spot.specular = glm::vec3(0.9f, 0.9f, 0.9f);
+    }
+    else {
+        spot.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+        spot.diffuse = glm::vec3(0.0f, 0.0f, 0.0f);
+        spot.specular = glm::vec3(0.0f, 0.0f, 0.0f);
+    }
+    spot.constant = 1.0f;
+    spot.linear = (itemsCollected > 0) ? 0.14f : 0.022f;
+    spot.quadratic = (itemsCollected > 0) ? 0.07f : 0.01f;
+    spot.cutOff = glm::cos(glm::radians(12.0f));
+    spot.outerCutOff = glm::cos(glm::radians(17.0f));
+    LightBuffer::Instance().SetSpotLight(spot);
+}
+
 unsigned int skyboxVAO = 0, skyboxVBO = 0;
 unsigned int cubemapTexture = 0;
 glm::vec3 fogColorVector = glm::vec3(0.05f, 0.05f, 0.05f);
 
+// Uniforms por cuadro de sceneShader / sceneInstancedShader (deja el shader activo)
+void setSceneUniforms(Shader* shader, const SceneUniforms& s, const glm::mat4& projection, const glm::mat4& view) {
+    shader->use();
+    shader->set(s.fogColor, fogColorVector);
+    shader->set(s.viewPos, camera.Position);
+    shader->set(s.projection, projection);
+    shader->set(s.view, view);
+}
+
 // --- FUNCIONES DE INTERFAZ ---
 void drawLoadingScreen()
 {
@@ -357,6 +498,14 @@ void drawLoadingScreen()
     ImGui::Text(loadingText.c_str());
     ImGui::SetWindowFontScale(1.0f);
 
+    // Barra de progreso (ponderada por bytes reales cargados)
+    float barWidth = windowWidth * 0.4f;
+    ImGui::SetCursorPosX((windowWidth - barWidth) * 0.5f);
+    ImGui::SetCursorPosY(windowHeight * 0.55f);
+    ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.6f, 0.0f, 0.0f, 1.0f));
+    ImGui::ProgressBar(loadingProgress, ImVec2(barWidth, 0.0f));
+    ImGui::PopStyleColor();
+
     ImGui::PopStyleColor();
     ImGui::End();
 }
@@ -487,6 +636,10 @@ void drawControlsScreen()
     ImGui::SetCursorPosX(controlsStartX);
     ImGui::Text("P - Ver posicion actual");
     ImGui::SetCursorPosX(controlsStartX);
+    ImGui::Text("L - Cambiar nivel de detalle (LOD)");
+    ImGui::SetCursorPosX(controlsStartX);
+    ImGui::Text("Q - Estadisticas de render (consola)");
+    ImGui::SetCursorPosX(controlsStartX);
     ImGui::Text("E - Recoger objeto");
     ImGui::SetCursorPosX(controlsStartX);
     ImGui::Text("ESC - Pausa/Salir del juego");
@@ -646,24 +799,102 @@ void drawCollectUI()
     ImGui::End();
 }
 
-void loadResources()
+// Opciones de carga de los modelos que dibuja sceneShader
+ModelLoadOptions sceneModelOptions()
+{
+    // scene.vs reconstruye las posiciones cuantizadas, así que todos los modelos usan el formato compacto
+    ModelLoadOptions options;
+    options.packVertices = true;
+    // solo se importan y suben los atributos que lee el shader (sin tangentes/bitangentes)
+    options.vertexAttributes = sceneShader->ActiveAttributeMask();
+    return options;
+}
+
+void startLoadingResources()
 {
-    loadingProgress = 0.2f;
-    environment = new Model("model/Pasillo/Pasillos.gltf");
+    ModelLoadOptions options = sceneModelOptions();
 
-    loadingProgress = 0.35f;
-    angelModel = new Model("model/angelMuerte/angelMuerte.obj");
+    // los modelos se importan en paralelo (un hilo por núcleo); se suben a la GPU en el orden de la cola
+    assetLoader = new AssetLoader();
+    assetLoader->QueueModel("model/Pasillo/Pasillos.gltf", &environment, options);
+    assetLoader->QueueModel("model/cassette/cinta.obj", &itemModel, options);
+    assetLoader->QueueModel("model/lampara1/lampara1.obj", &lampModel, options);
 
-    loadingProgress = 0.5f;
-    itemModel = new Model("model/cassette/cinta.obj");
-    lampModel = new Model("model/lampara1/lampara1.obj");
-    mujerModel = new Model("model/mujerTerror/mujerTerror.obj");
+    // Skybox: las caras se decodifican en el hilo de carga, el cubemap se crea en el hilo GL
+    std::vector<std::string> faces{
+        "textures/skybox/right.png", "textures/skybox/left.png",
+        "textures/skybox/top.png",   "textures/skybox/bottom.png",
+        "textures/skybox/front.png", "textures/skybox/back.png"
+    };
+    uint64_t skyboxBytes = 0;
+    for (const std::string& face : faces) {
+        FileStamp stamp;
+        if (GetAssetStamp(face, stamp)) skyboxBytes += stamp.size;
+    }
+    std::shared_ptr<std::vector<DecodedImage>> skyboxFaces = std::make_shared<std::vector<DecodedImage>>();
+    std::shared_ptr<TextureUpload> skyboxUpload = std::make_shared<TextureUpload>();
+    assetLoader->Queue("skybox", skyboxBytes,
+        [faces, skyboxFaces]() {
+            for (const std::string& face : faces) skyboxFaces->push_back(DecodeImageFile(face));
+        },
+        // las caras pasan por los PBO por franjas, dentro del presupuesto del frame
+        [skyboxFaces, skyboxUpload](size_t& budget) {
+            if (!skyboxUpload->Started()) cubemapTexture = skyboxUpload->StartCubemap(std::move(*skyboxFaces));
+            size_t sent = skyboxUpload->Step(budget);
+            budget -= std::min(sent, budget);
+            return skyboxUpload->Done();
+        },
+        [skyboxUpload]() {
+            return skyboxUpload->TotalBytes() ? (float)skyboxUpload->SentBytes() / skyboxUpload->TotalBytes() : 0.0f;
+        });
+
+    assetLoader->Start();
+}
 
-    loadingProgress = 0.65f;
-    screamerModel = new Model("model/bebeTerror/bebeTerror.obj");
-    currentScreamerModel = screamerModel;
+// Lo que queda de la carga, en el hilo GL, cuando todos los recursos están en la GPU
+void finishLoadingResources()
+{
+    delete assetLoader;
+    assetLoader = nullptr;
+
+    // los props comparten shader: con sus texturas en arreglos se dibujan seguidos sin cambiar de textura
+    // (las texturas 2D originales se liberan: solo quedan en los arreglos)
+    Model::PackTextureArrays({ lampModel.get(), itemModel.get() }, propTextureArrays);
+
+    // Modelos de eventos: cada uno se necesita cerca de sus disparadores mientras el evento no haya terminado
+    modelStreamer = new ModelStreamer(STREAMING_RADIUS, STREAMING_MEMORY_BUDGET, sceneModelOptions());
+    int streamed[] = {
+        modelStreamer->AddModel("model/angelMuerte/angelMuerte.obj", &angelModel),  // MODEL_ANGEL
+        modelStreamer->AddModel("model/bebeTerror/bebeTerror.obj", &screamerModel), // MODEL_SCREAMER
+        -1, -1,
+        modelStreamer->AddModel("model/mujerTerror/mujerTerror.obj", &mujerModel)   // MODEL_MUJER
+    };
+    modelStreamer->AddTrigger(streamed[MODEL_ANGEL], angelPos, []() { return !angelGone; });
+    for (size_t i = 0; i < dynamicProps.size(); i++) {
+        if (streamed[dynamicProps[i].modelType] < 0) continue;
+        modelStreamer->AddTrigger(streamed[dynamicProps[i].modelType], dynamicProps[i].startPos,
+            [i]() { return !dynamicProps[i].isFinished; });
+    }
+    for (size_t i = 0; i < proximityScreamers.size(); i++) {
+        if (streamed[proximityScreamers[i].modelType] < 0) continue;
+        // sigue haciendo falta mientras dura el susto en pantalla
+        modelStreamer->AddTrigger(streamed[proximityScreamers[i].modelType], proximityScreamers[i].position,
+            [i]() { return !proximityScreamers[i].isTriggered || (screamerTriggered && screamerTimer < SCREAMER_DURATION); });
+    }
+    // Los modelos de eventos no van a los arreglos de texturas: armarlos lee las texturas de vuelta
+    // de la GPU, justo el tirón que el streaming evita durante el juego
+
+    ModelRegistry::Instance().PrintMemoryReport(std::cout);
+    propTextureArrays.PrintReport(std::cout);
+    // texturas idénticas en carpetas distintas (p. ej. Pueblo / Town) se cargan una sola vez
+    TextureCache::Instance().PrintDedupReport(std::cout);
+    if (!TextureCache::Instance().SaveContentHashes(TEXTURE_HASHES_PATH))
+        std::cout << "No se pudo escribir " << TEXTURE_HASHES_PATH << std::endl;
+    // reporte de tiempos de carga; el JSON sirve para comparar entre versiones
+    LoadProfiler::Instance().PrintReport(std::cout);
+    if (!LoadProfiler::Instance().WriteJsonFile("load_profile.json"))
+        std::cout << "No se pudo escribir load_profile.json" << std::endl;
 
-    loadingProgress = 0.75f;
     srand(time(NULL));
     for (int i = 0; i < MAX_RAIN_DROPS; i++) {
         RainDrop drop;
@@ -675,7 +906,6 @@ void loadResources()
     glGenVertexArrays(1, &rainVAO);
     glGenBuffers(1, &rainVBO);
 
-    loadingProgress = 0.9f;
     float skyboxVertices[] = {
         -10.0f,  10.0f, -10.0f, -10.0f, -10.0f, -10.0f,  10.0f, -10.0f, -10.0f,
          10.0f, -10.0f, -10.0f,  10.0f,  10.0f, -10.0f, -10.0f,  10.0f, -10.0f,
@@ -698,13 +928,6 @@ void loadResources()
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-    std::vector<std::string> faces{
-        "textures/skybox/right.png", "textures/skybox/left.png",
-        "textures/skybox/top.png",   "textures/skybox/bottom.png",
-        "textures/skybox/front.png", "textures/skybox/back.png"
-    };
-    cubemapTexture = loadCubemap(faces);
-
     skyboxShader->use();
     skyboxShader->setInt("skybox", 0);
 
@@ -743,6 +966,10 @@ int main()
         return -1;
     }
 
+    // texturas de los modelos comprimidas (BC1/BC3/BC4) y guardadas como .dds junto a la imagen, si el driver soporta S3TC
+    if (!EnableTextureCompression())
+        std::cout << "S3TC no disponible, texturas sin comprimir" << std::endl;
+
     glEnable(GL_DEPTH_TEST);
 
     IMGUI_CHECKVERSION();
@@ -753,29 +980,48 @@ int main()
     ImGui_ImplOpenGL3_Init("#version 330");
     glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 
+    // mide cada etapa de la carga desde aquí (shaders incluidos) hasta finishLoadingResources
+    LoadProfiler::Instance().Begin();
+    if (!MountAssetPack(ASSET_PACK_PATH))
+        std::cout << "Sin " << ASSET_PACK_PATH << ", se usan los archivos sueltos" << std::endl;
+    TextureCache::Instance().LoadContentHashes(TEXTURE_HASHES_PATH);
     sceneShader = new Shader("shaders/scene.vs", "shaders/scene.fs");
+    sceneInstancedShader = new Shader("shaders/scene_instanced.vs", "shaders/scene.fs");
     skyboxShader = new Shader("shaders/skybox.vs", "shaders/skybox.fs");
     rainShader = new Shader("shaders/rain.vs", "shaders/rain.fs");
+    resolveShaderUniforms();
+    setupLampLights();
+    setupLampInstances();
 
     stbi_set_flip_vertically_on_load(false);
 
+    startLoadingResources();
     while (gameState == LOADING)
     {
+        float currentFrame = glfwGetTime();
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
         glfwPollEvents();
+        assetLoader->Update(UPLOAD_BUDGET_PER_FRAME);
+        loadingProgress = assetLoader->Progress();
+
         ImGui_ImplOpenGL3_NewFrame(); ImGui_ImplGlfw_NewFrame(); ImGui::NewFrame();
         glClearColor(0.0f, 0.0f, 0.0f, 1); glClear(GL_COLOR_BUFFER_BIT);
         drawLoadingScreen();
         ImGui::Render(); ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         glfwSwapBuffers(window);
-        loadResources();
+
+        if (!assetLoader->Done()) continue;
+        finishLoadingResources();
         if (SDL_Init(SDL_INIT_AUDIO) < 0) std::cout << "Error SDL_AUDIO\n";
         if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0) std::cout << "Error SDL_mixer\n";
-        flashlightSound = Mix_LoadWAV("audio/flashlight_click.wav");
-        footstepSound = Mix_LoadWAV("audio/footstep.wav");
-        screamerSound = Mix_LoadWAV("audio/scream.wav");
-        rainSound = Mix_LoadWAV("audio/rain.wav");
-        gameAmbientMusic = Mix_LoadMUS("audio/ambient.wav");
-        menuMusic = Mix_LoadMUS("audio/menu_music.wav");
+        flashlightSound = loadSound("audio/flashlight_click.wav");
+        footstepSound = loadSound("audio/footstep.wav");
+        screamerSound = loadSound("audio/scream.wav");
+        rainSound = loadSound("audio/rain.wav");
+        gameAmbientMusic = loadMusic("audio/ambient.wav");
+        menuMusic = loadMusic("audio/menu_music.wav");
         gameState = MENU;
     }
 
@@ -785,6 +1031,8 @@ int main()
         ImGui_ImplOpenGL3_NewFrame(); ImGui_ImplGlfw_NewFrame(); ImGui::NewFrame();
         glClearColor(0.05f, 0.05f, 0.05f, 1); glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         if (menuMusic && Mix_PlayingMusic() == 0) Mix_PlayMusic(menuMusic, -1);
+        // precarga los eventos cercanos al punto de inicio mientras se está en el menú
+        modelStreamer->Update(camera.Position, STREAMING_UPLOAD_PER_FRAME);
         if (gameState == MENU) drawMenuScreen();
         else if (gameState == CONTROLES_MENU) drawControlsScreen();
         ImGui::Render(); ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -800,8 +1048,6 @@ int main()
         if (gameState == JUGANDO) processInput(window);
         if (gameState == JUGANDO) gameTime += deltaTime;
 
-        float flicker = 1.0f; // CONSTANTE: Sin parpadeo, luz siempre prendida
-
         // --- ACTUALIZAR PROPS MÓVILES ---
         if (gameState == JUGANDO) {
             for (auto& prop : dynamicProps) {
@@ -902,9 +1148,13 @@ int main()
             if (screamerTimer >= SCREAMER_DURATION) {
                 flashlightOn = true; // Asegurar que quede encendida al terminar
                 Mix_VolumeMusic(ambientBaseVolume);
+                currentScreamerModel.reset(); // suelta el modelo para que se pueda liberar
             }
         }
 
+        // Carga/libera los modelos de eventos según la posición del jugador
+        modelStreamer->Update(camera.Position, STREAMING_UPLOAD_PER_FRAME);
+
         // SONIDO DE PASOS
         if (gameState == JUGANDO && isMoving && footstepSound)
         {
@@ -934,113 +1184,50 @@ int main()
 
         if (gameState == JUGANDO || gameState == PAUSED)
         {
-            sceneShader->use();
-
-            // --- LUCES DE LÁMPARAS - MÁS INTENSAS CON MENOR RANGO ---
-            sceneShader->setInt("numPointLights", lamps.size());
-            for (int i = 0; i < lamps.size(); i++)
-            {
-                std::string idx = "pointLights[" + std::to_string(i) + "]";
-                sceneShader->setVec3(idx + ".position", lamps[i].pos + glm::vec3(0.0f, 0.4f, 0.0f));
-
-                // Luz más intensa
-                sceneShader->setVec3(idx + ".ambient", glm::vec3(0.08f * flicker));
-                sceneShader->setVec3(idx + ".diffuse", glm::vec3(1.0f * flicker, 1.0f * flicker, 1.0f * flicker));
-                sceneShader->setVec3(idx + ".specular", glm::vec3(0.5f * flicker));
-
-                sceneShader->setFloat(idx + ".constant", 1.0f);
-                sceneShader->setFloat(idx + ".linear", 0.22f);  // Rango más corto
-                sceneShader->setFloat(idx + ".quadratic", 0.08f); // Más rápido falloff
-            }
+            // --- LUCES: lámparas (ya subidas) y linterna, en el LightBuffer ---
+            updateFlashlight();
+            LightBuffer::Instance().Upload();
 
             // Niebla
             if (itemsCollected == 0) fogColorVector = glm::vec3(0.05f, 0.05f, 0.05f);
             else if (itemsCollected == 1) fogColorVector = glm::vec3(0.03f, 0.03f, 0.04f);
             else if (itemsCollected == 2) fogColorVector = glm::vec3(0.01f, 0.01f, 0.02f);
             else if (itemsCollected >= 3) fogColorVector = glm::vec3(0.0f, 0.0f, 0.0f);
-            sceneShader->setVec3("fogColor", fogColorVector);
-
-            sceneShader->setVec3("viewPos", camera.Position);
-            sceneShader->setVec3("spotLight.position", camera.Position);
-            sceneShader->setVec3("spotLight.direction", camera.Front);
-
-            if (flashlightOn) {
-                sceneShader->setVec3("spotLight.ambient", 0.9f, 0.9f, 0.9f);
-                sceneShader->setVec3("spotLight.diffuse", 0.4f, 0.4f, 0.4f);
-                sceneShader->setVec3("spotLight.specular", 0.9f, 0.9f, 0.9f);
-            }
-            else {
-                sceneShader->setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-                sceneShader->setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
-                sceneShader->setVec3("spotLight.specular", 0.0f, 0.0f, 0.0f);
-            }
-
-            sceneShader->setFloat("spotLight.constant", 1.0f);
-            sceneShader->setFloat("spotLight.linear", (itemsCollected > 0) ? 0.14f : 0.022f);
-            sceneShader->setFloat("spotLight.quadratic", (itemsCollected > 0) ? 0.07f : 0.01f);
-            sceneShader->setFloat("spotLight.cutOff", glm::cos(glm::radians(12.0f)));
-            sceneShader->setFloat("spotLight.outerCutOff", glm::cos(glm::radians(17.0f)));
 
             glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)mode->width / (float)mode->height, 0.1f, 100.0f);
             glm::mat4 view = camera.GetViewMatrix();
-            sceneShader->setMat4("projection", projection);
-            sceneShader->setMat4("view", view);
+            setSceneUniforms(sceneShader, sceneUniforms, projection, view);
+            setSceneUniforms(sceneInstancedShader, sceneInstancedUniforms, projection, view);
+            // Lo que queda fuera de la cámara (según las cajas y esferas de cada malla) no se encola
+            renderQueue.SetFrustum(Frustum(projection * view));
 
             // Dibujar Entorno
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, glm::vec3(0.0f, GROUND_HEIGHT, 0.0f));
-            sceneShader->setMat4("model", model);
-            if (environment) environment->Draw(*sceneShader);
+            if (environment) renderQueue.Submit(*environment, *sceneShader, model, camera.Position);
 
-            // --- DIBUJAR LÁMPARAS ---
-            for (const Lamp& lamp : lamps)
-            {
-                glm::mat4 model = glm::mat4(1.0f);
-                model = glm::translate(model, lamp.pos + glm::vec3(0.0f, 0.75f, 0.0f));
-                model = glm::rotate(model, glm::radians(lamp.rotY), glm::vec3(0, 1, 0));
-                model = glm::translate(model, glm::vec3(0.0f, 0.0f, -0.25f));
-                model = glm::scale(model, glm::vec3(0.4f));
-                sceneShader->setMat4("model", model);
-                if (lampModel) lampModel->Draw(*sceneShader);
-            }
+            // --- DIBUJAR LÁMPARAS --- (todas en una llamada por malla)
+            if (lampModel) renderQueue.SubmitInstanced(*lampModel, *sceneInstancedShader, lampInstances, camera.Position);
 
             // --- VARIABLES DE ANIMACIÓN ---
             float hoverOffset = sin(gameTime * 2.0f) * 0.1f;
             float rotationAngle = gameTime * 45.0f;
 
-            // --- DIBUJAR ITEMS ---
-            if (!haveItem1) {
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, item1Pos + glm::vec3(0.0f, 0.5f + hoverOffset, 0.0f));
-                model = glm::rotate(model, glm::radians(rotationAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-                model = glm::scale(model, glm::vec3(0.1f));
-                sceneShader->setMat4("model", model);
-                if (itemModel) itemModel->Draw(*sceneShader);
-            }
-            if (!haveItem2) {
+            // --- DIBUJAR ITEMS --- (los cassettes que quedan, en una llamada por malla)
+            const glm::vec3 itemPositions[4] = { item1Pos, item2Pos, item3Pos, item4Pos };
+            const bool itemTaken[4] = { haveItem1, haveItem2, haveItem3, haveItem4 };
+            static std::vector<glm::mat4> itemMatrices;
+            itemMatrices.clear();
+            for (int i = 0; i < 4; i++) {
+                if (itemTaken[i]) continue;
                 model = glm::mat4(1.0f);
-                model = glm::translate(model, item2Pos + glm::vec3(0.0f, 0.5f + hoverOffset, 0.0f));
+                model = glm::translate(model, itemPositions[i] + glm::vec3(0.0f, 0.5f + hoverOffset, 0.0f));
                 model = glm::rotate(model, glm::radians(rotationAngle), glm::vec3(0.0f, 1.0f, 0.0f));
                 model = glm::scale(model, glm::vec3(0.1f));
-                sceneShader->setMat4("model", model);
-                if (itemModel) itemModel->Draw(*sceneShader);
-            }
-            if (!haveItem3) {
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, item3Pos + glm::vec3(0.0f, 0.5f + hoverOffset, 0.0f));
-                model = glm::rotate(model, glm::radians(rotationAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-                model = glm::scale(model, glm::vec3(0.1f));
-                sceneShader->setMat4("model", model);
-                if (itemModel) itemModel->Draw(*sceneShader);
-            }
-            if (!haveItem4) {
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, item4Pos + glm::vec3(0.0f, 0.5f + hoverOffset, 0.0f));
-                model = glm::rotate(model, glm::radians(rotationAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-                model = glm::scale(model, glm::vec3(0.1f));
-                sceneShader->setMat4("model", model);
-                if (itemModel) itemModel->Draw(*sceneShader);
+                itemMatrices.push_back(model);
             }
+            itemInstances.Upload(itemMatrices);
+            if (itemModel) renderQueue.SubmitInstanced(*itemModel, *sceneInstancedShader, itemInstances, camera.Position);
 
             // Ángel
             if (!angelGone) {
@@ -1049,8 +1236,7 @@ int main()
                     model = glm::translate(model, angelPos);
                     model = glm::rotate(model, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
                     model = glm::scale(model, glm::vec3(3.0f));
-                    sceneShader->setMat4("model", model);
-                    if (angelModel) angelModel->Draw(*sceneShader);
+                    if (angelModel) renderQueue.Submit(*angelModel, *sceneShader, model, camera.Position);
                 }
             }
 
@@ -1062,23 +1248,22 @@ int main()
                     float angle = atan2(prop.moveDir.x, prop.moveDir.z);
                     model = glm::rotate(model, angle + glm::radians(prop.rotationOffset), glm::vec3(0, 1, 0));
                     model = glm::scale(model, prop.scale);
-                    sceneShader->setMat4("model", model);
 
                     switch (prop.modelType) {
                     case MODEL_ANGEL:
-                        if (angelModel) angelModel->Draw(*sceneShader);
+                        if (angelModel) renderQueue.Submit(*angelModel, *sceneShader, model, camera.Position);
                         break;
                     case MODEL_SCREAMER:
-                        if (screamerModel) screamerModel->Draw(*sceneShader);
+                        if (screamerModel) renderQueue.Submit(*screamerModel, *sceneShader, model, camera.Position);
                         break;
                     case MODEL_ITEM:
-                        if (itemModel) itemModel->Draw(*sceneShader);
+                        if (itemModel) renderQueue.Submit(*itemModel, *sceneShader, model, camera.Position);
                         break;
                     case MODEL_LAMP:
-                        if (lampModel) lampModel->Draw(*sceneShader);
+                        if (lampModel) renderQueue.Submit(*lampModel, *sceneShader, model, camera.Position);
                         break;
                     case MODEL_MUJER:
-                        if (mujerModel) mujerModel->Draw(*sceneShader);
+                        if (mujerModel) renderQueue.Submit(*mujerModel, *sceneShader, model, camera.Position);
                         break;
                     }
                 }
@@ -1091,23 +1276,21 @@ int main()
                     modelStatic = glm::rotate(modelStatic, glm::radians(s.rotationOffset), glm::vec3(0, 1, 0));
                     modelStatic = glm::scale(modelStatic, s.scale);
 
-                    sceneShader->setMat4("model", modelStatic);
-
                     switch (s.modelType) {
                     case MODEL_ANGEL:
-                        if (angelModel) angelModel->Draw(*sceneShader);
+                        if (angelModel) renderQueue.Submit(*angelModel, *sceneShader, modelStatic, camera.Position);
                         break;
                     case MODEL_SCREAMER:
-                        if (screamerModel) screamerModel->Draw(*sceneShader);
+                        if (screamerModel) renderQueue.Submit(*screamerModel, *sceneShader, modelStatic, camera.Position);
                         break;
                     case MODEL_ITEM:
-                        if (itemModel) itemModel->Draw(*sceneShader);
+                        if (itemModel) renderQueue.Submit(*itemModel, *sceneShader, modelStatic, camera.Position);
                         break;
                     case MODEL_LAMP:
-                        if (lampModel) lampModel->Draw(*sceneShader);
+                        if (lampModel) renderQueue.Submit(*lampModel, *sceneShader, modelStatic, camera.Position);
                         break;
                     case MODEL_MUJER:
-                        if (mujerModel) mujerModel->Draw(*sceneShader);
+                        if (mujerModel) renderQueue.Submit(*mujerModel, *sceneShader, modelStatic, camera.Position);
                         break;
                     }
                 }
@@ -1135,17 +1318,19 @@ int main()
                 // 3. Escala
                 modelScreamer = glm::scale(modelScreamer, activeScreamerScale);
 
-                sceneShader->setMat4("model", modelScreamer);
-                currentScreamerModel->Draw(*sceneShader);
+                renderQueue.Submit(*currentScreamerModel, *sceneShader, modelScreamer, camera.Position);
             }
 
+            // Todo lo encolado: ordenado por shader, material, VAO y profundidad
+            renderQueue.Flush();
+
             // Lluvia
             if (gameState == JUGANDO && rainEnabled && rainShader) {
                 glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
                 rainShader->use();
-                rainShader->setMat4("projection", projection); rainShader->setMat4("view", view);
-                rainShader->setVec3("spotLightPos", camera.Position); rainShader->setVec3("spotLightDir", camera.Front);
-                rainShader->setBool("flashlightOn", flashlightOn);
+                rainShader->set(rainUniforms.projection, projection); rainShader->set(rainUniforms.view, view);
+                rainShader->set(rainUniforms.spotLightPos, camera.Position); rainShader->set(rainUniforms.spotLightDir, camera.Front);
+                rainShader->set(rainUniforms.flashlightOn, flashlightOn);
                 std::vector<float> rainVertices;
                 for (auto& drop : rainDrops) {
                     drop.position.y -= drop.speed * deltaTime;
@@ -1164,7 +1349,7 @@ int main()
             // Skybox
             glDepthFunc(GL_LEQUAL); skyboxShader->use();
             view = glm::mat4(glm::mat3(camera.GetViewMatrix()));
-            skyboxShader->setMat4("view", view); skyboxShader->setMat4("projection", projection);
+            skyboxShader->set(skyboxUniforms.view, view); skyboxShader->set(skyboxUniforms.projection, projection);
             glBindVertexArray(skyboxVAO); glActiveTexture(GL_TEXTURE0); glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
             glDrawArrays(GL_TRIANGLES, 0, 36); glBindVertexArray(0); glDepthFunc(GL_LESS);
 
@@ -1191,22 +1376,33 @@ int main()
         glfwPollEvents();
     }
 
+    // Limpieza: los modelos se liberan con su último handle y devuelven sus texturas compartidas,
+    // así que el contexto GL debe seguir vivo
+    currentScreamerModel.reset();
+    if (modelStreamer) { modelStreamer->clear(); delete modelStreamer; }
+    environment.reset();
+    angelModel.reset();
+    itemModel.reset();
+    lampModel.reset();
+    mujerModel.reset();
+    screamerModel.reset();
+    ModelRegistry::Instance().clear();
+    propTextureArrays.clear();
+    ClearMeshGeometry();
+    PixelUploadRing::Instance().clear();
+    LightBuffer::Instance().clear();
+    lampInstances.clear();
+    itemInstances.clear();
+    if (rainShader) delete rainShader;
+    if (sceneShader) delete sceneShader;
+    if (sceneInstancedShader) delete sceneInstancedShader;
+    if (skyboxShader) delete skyboxShader;
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
     glfwTerminate();
 
-    // Limpieza
-    if (environment) delete environment;
-    if (angelModel) delete angelModel;
-    if (itemModel) delete itemModel;
-    if (lampModel) delete lampModel;
-    if (mujerModel) delete mujerModel;
-    if (screamerModel) delete screamerModel;
-    if (rainShader) delete rainShader;
-    if (sceneShader) delete sceneShader;
-    if (skyboxShader) delete skyboxShader;
-
     Mix_FreeChunk(flashlightSound);
     Mix_FreeChunk(footstepSound);
     Mix_FreeChunk(screamerSound);
@@ -1256,6 +1452,23 @@ void processInput(GLFWwindow* window)
     static bool rPress = false;
     if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !rPress) { rainEnabled = !rainEnabled; rPress = true; if (rainEnabled) { if (rainSoundChannel == -1) rainSoundChannel = Mix_PlayChannel(-1, rainSound, -1); } else { Mix_HaltChannel(rainSoundChannel); rainSoundChannel = -1; } }
     if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE) rPress = false;
+    // L: alterna el nivel de detalle forzado (auto, 0..3) para comparar rendimiento
+    static bool lPress = false;
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !lPress) {
+        LodSettings& lod = ModelLodSettings();
+        lod.forcedLevel = lod.forcedLevel + 1 < MESH_MAX_LODS ? lod.forcedLevel + 1 : -1;
+        if (lod.forcedLevel < 0) std::cout << "LOD: automatico" << std::endl;
+        else std::cout << "LOD: forzado al nivel " << lod.forcedLevel << std::endl;
+        lPress = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE) lPress = false;
+    // Q: muestra cuántos cambios de estado ahorró la cola de render en el último cuadro
+    static bool qPress = false;
+    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS && !qPress) {
+        renderQueue.PrintStats(std::cout);
+        qPress = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_RELEASE) qPress = false;
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) { glViewport(0, 0, width, height); }
@@ -1281,26 +1494,17 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
     }
 }
 
-unsigned int loadCubemap(std::vector<std::string> faces) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++) {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else {
-            std::cout << "Cubemap failed: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    return textureID;
-}
\ No newline at end of file
+// Audio desde el paquete de recursos si lo tiene; el paquete sigue mapeado hasta el final,
+// así que la música puede leerse de él mientras suena
+Mix_Chunk* loadSound(const char* path) {
+    const AssetPackEntry* entry = MountedAssetPack().Find(path);
+    if (!entry) return Mix_LoadWAV(path);
+    return Mix_LoadWAV_RW(SDL_RWFromConstMem(MountedAssetPack().Data(*entry), (int)entry->size), 1);
+}
+
+Mix_Music* loadMusic(const char* path) {
+    const AssetPackEntry* entry = MountedAssetPack().Find(path);
+    if (!entry) return Mix_LoadMUS(path);
+    return Mix_LoadMUS_RW(SDL_RWFromConstMem(MountedAssetPack().Data(*entry), (int)entry->size), 1);
+}
+
@@ -8,6 +8,7 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/model_registry.h>
 
 #include <iostream>
 
@@ -131,7 +132,7 @@ int main()
     // load models
     // -----------
     //Model ourModel(FileSystem::getPath("resources/objects/backpack/backpack.obj"));
-    Model ourModel("C:/Users/NETWORKS/Documents/Visual Studio 2022/Open_GL/Open_GL/model/huesos/huesos.obj");
+    ModelHandle ourModel = ModelRegistry::Instance().Load("C:/Users/NETWORKS/Documents/Visual Studio 2022/Open_GL/Open_GL/model/huesos/huesos.obj");
     //Model ourModel("model/backpack/backpack.obj");
 
     std::srand((unsigned)time(nullptr));
@@ -251,7 +252,7 @@ int main()
             model = glm::scale(model, glm::vec3(1.0f));
 
             ourShader.setMat4("model", model);
-            ourModel.Draw(ourShader);
+            ourModel->Draw(ourShader);
         }
 
 
@@ -282,6 +283,9 @@ int main()
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
+    // free the model while the context still exists
+    ourModel.reset();
+    ModelRegistry::Instance().clear();
     glfwTerminate();
     return 0;
 }
@@ -5,37 +5,41 @@ uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
 uniform sampler2D texture_emissive1;
 
+// props con sus texturas en un GL_TEXTURE_2D_ARRAY: capa de la malla, -1 = usar texture_diffuse1/texture_specular1
+uniform sampler2DArray diffuseArray;
+uniform sampler2DArray specularArray;
+uniform int diffuseLayer;
+uniform int specularLayer;
+
 uniform bool hasEmissive;
 uniform float emissiveStrength;
 
 // --- ESTRUCTURAS DE LUCES ---
+// En bloques uniform std140 compartidos con el programa (learnopengl/light_buffer.h):
+// cada float va después de un vec3 para ocupar su cuarto componente, no cambiar el orden.
 #define MAX_LAMPS 32
 
 struct PointLight {
     vec3 position;
-    
     float constant;
-    float linear;
-    float quadratic;
-    
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
     float cutOff;
+    vec3 direction;
     float outerCutOff;
-  
+    vec3 ambient;
     float constant;
+    vec3 diffuse;
     float linear;
+    vec3 specular;
     float quadratic;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;        
 };
 
 in vec3 FragPos;
@@ -43,13 +47,35 @@ in vec3 Normal;
 in vec2 TexCoords;
 
 uniform vec3 viewPos;
-uniform SpotLight spotLight;
-uniform int numPointLights;
-uniform PointLight pointLights[MAX_LAMPS];
+
+// lámparas: se suben una vez al cargar
+layout(std140) uniform PointLightBlock {
+    PointLight pointLights[MAX_LAMPS];
+    int numPointLights;
+};
+
+// linterna: se actualiza cada cuadro
+layout(std140) uniform SpotLightBlock {
+    SpotLight spotLight;
+};
 
 // --- Uniform para el color de la niebla ---
 uniform vec3 fogColor;
 
+vec3 DiffuseColor()
+{
+    if (diffuseLayer >= 0)
+        return texture(diffuseArray, vec3(TexCoords, float(diffuseLayer))).rgb;
+    return texture(texture_diffuse1, TexCoords).rgb;
+}
+
+vec3 SpecularColor()
+{
+    if (specularLayer >= 0)
+        return texture(specularArray, vec3(TexCoords, float(specularLayer))).rgb;
+    return texture(texture_specular1, TexCoords).rgb;
+}
+
 // --- FUNCIÓN DE CÁLCULO DE PUNTO LUZ COMO FOCO CUADRADO ---
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
@@ -106,9 +132,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
         edgeSmooth *= (1.0 - (localZ - boxDepth * 0.8) / (boxDepth * 0.2));
     }
 
-    vec3 ambient  = light.ambient  * vec3(texture(texture_diffuse1, TexCoords));
-    vec3 diffuse  = light.diffuse  * diff * vec3(texture(texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(texture_specular1, TexCoords));
+    vec3 ambient  = light.ambient  * DiffuseColor();
+    vec3 diffuse  = light.diffuse  * diff * DiffuseColor();
+    vec3 specular = light.specular * spec * SpecularColor();
 
     // Aplicar atenuación y suavizado
     ambient  *= attenuation * edgeSmooth;
@@ -137,16 +163,16 @@ void main()
     float intensity = clamp((theta - spotLight.outerCutOff) / epsilon, 0.0, 1.0);
     
     // Ambiente (siempre hay un poco de luz)
-    vec3 ambient = spotLight.ambient * vec3(texture(texture_diffuse1, TexCoords));
+    vec3 ambient = spotLight.ambient * DiffuseColor();
     
     // Difusa
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = spotLight.diffuse * diff * vec3(texture(texture_diffuse1, TexCoords));
+    vec3 diffuse = spotLight.diffuse * diff * DiffuseColor();
     
     // Especular
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
-    vec3 specular = spotLight.specular * spec * vec3(texture(texture_specular1, TexCoords));
+    vec3 specular = spotLight.specular * spec * SpecularColor();
     
     // Aplicar factores
     ambient *= attenuation * intensity;
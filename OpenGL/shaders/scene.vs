@@ -11,9 +11,15 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// mallas con formato compacto: aPos llega en 0..1 dentro de la caja de la malla
+uniform bool quantizedPositions;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    vec3 position = quantizedPositions ? aPos * positionScale + positionOffset : aPos;
+    FragPos = vec3(model * vec4(position, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;  
     TexCoords = aTexCoords; // Pasamos vec2 a vec2
     
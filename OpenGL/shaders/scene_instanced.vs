@@ -0,0 +1,29 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// matriz de modelo de cada copia (ocupa las ubicaciones 7 a 10), ver learnopengl/instance_buffer.h
+layout (location = 7) in mat4 aInstanceModel;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// mallas con formato compacto: aPos llega en 0..1 dentro de la caja de la malla
+uniform bool quantizedPositions;
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+// igual que scene.vs, pero con la matriz de modelo por instancia en lugar del uniform 'model'
+void main()
+{
+    vec3 position = quantizedPositions ? aPos * positionScale + positionOffset : aPos;
+    FragPos = vec3(aInstanceModel * vec4(position, 1.0));
+    Normal = mat3(transpose(inverse(aInstanceModel))) * aNormal;
+    TexCoords = aTexCoords;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
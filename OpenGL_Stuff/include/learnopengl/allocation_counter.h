@@ -0,0 +1,76 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Counts heap allocations made through global operator new, to see how much allocator traffic a load
+// does. The counting operators are only compiled in one translation unit, like stb_image:
+//     #define ALLOCATION_COUNTER_IMPLEMENTATION
+//     #include <learnopengl/allocation_counter.h>
+// Without it the counters simply stay at zero.
+
+struct AllocationSnapshot {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+inline std::atomic<uint64_t> &AllocationCountCounter()
+{
+    static std::atomic<uint64_t> counter(0);
+    return counter;
+}
+
+inline std::atomic<uint64_t> &AllocatedBytesCounter()
+{
+    static std::atomic<uint64_t> counter(0);
+    return counter;
+}
+
+// allocations and bytes requested since the program started
+inline AllocationSnapshot CurrentAllocations()
+{
+    AllocationSnapshot snapshot;
+    snapshot.count = AllocationCountCounter().load(std::memory_order_relaxed);
+    snapshot.bytes = AllocatedBytesCounter().load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+// allocations made between 'from' and now
+inline AllocationSnapshot AllocationsSince(const AllocationSnapshot &from)
+{
+    AllocationSnapshot now = CurrentAllocations();
+    now.count -= from.count;
+    now.bytes -= from.bytes;
+    return now;
+}
+#endif
+
+// outside the include guard, so the defining file can include the header after another header did
+#if defined(ALLOCATION_COUNTER_IMPLEMENTATION) && !defined(ALLOCATION_COUNTER_IMPLEMENTED)
+#define ALLOCATION_COUNTER_IMPLEMENTED
+#include <cstdlib>
+#include <new>
+
+// the array and nothrow forms of the standard library forward to these
+void *operator new(std::size_t size)
+{
+    AllocationCountCounter().fetch_add(1, std::memory_order_relaxed);
+    AllocatedBytesCounter().fetch_add(size, std::memory_order_relaxed);
+    void *memory = std::malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+#endif
@@ -296,15 +296,12 @@ private:
         dest.transformation = ConvertMatrixToGLMFormat(src->mTransformation);
         dest.childrenCount = (int)src->mNumChildren;
 
+        // children are built in place: copying a finished child would copy its whole subtree
         dest.children.clear();
-        dest.children.reserve(src->mNumChildren);
+        dest.children.resize(src->mNumChildren);
 
         for (unsigned int i = 0; i < src->mNumChildren; i++)
-        {
-            AssimpNodeData newData;
-            ReadHeirarchyData(newData, src->mChildren[i]);
-            dest.children.push_back(newData);
-        }
+            ReadHeirarchyData(dest.children[i], src->mChildren[i]);
     }
 };
 
@@ -0,0 +1,218 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <learnopengl/model.h>
+#include <learnopengl/model_registry.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mapped_file.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Loads assets on background threads while the GL thread keeps rendering.
+// Every job has an import step (file I/O, parsing, decoding) that runs on one of the loader's worker
+// threads and an upload step that runs on the GL thread from Update(), under a per-frame byte budget.
+// Jobs are independent: workers take them in queue order and import several at once (each Model has
+// its own Assimp::Importer), so a cold load takes about as long as its largest jobs rather than the
+// sum of all of them. Uploads still happen strictly in the order the jobs were queued, whatever order
+// the imports finish in, so the GL side is the same on every run. Progress is weighted by the
+// on-disk size of each job.
+class AssetLoader
+{
+public:
+    // share of a job's weight credited when its import finishes; the rest follows its upload
+    static constexpr float IMPORT_SHARE = 0.75f;
+
+    // 'workerCount' import threads at most (never more than there are jobs); 0 picks one per core,
+    // minus the GL thread
+    explicit AssetLoader(unsigned int workerCount = 0)
+        : maxWorkers(workerCount > 0 ? workerCount : DefaultWorkerCount())
+    {
+    }
+
+    AssetLoader(const AssetLoader &) = delete;
+    AssetLoader &operator=(const AssetLoader &) = delete;
+
+    static unsigned int DefaultWorkerCount()
+    {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 1;
+    }
+
+    // waits for the workers. must run on the GL thread: models imported but not uploaded yet are deleted.
+    ~AssetLoader()
+    {
+        joinWorkers();
+        for (std::unordered_map<std::string, std::shared_ptr<ModelJob>>::iterator it = modelJobs.begin(); it != modelJobs.end(); ++it)
+            delete it->second->model;
+    }
+
+    // 'import' runs on the loader thread. 'upload' runs on the GL thread, gets the remaining byte budget of
+    // the frame, subtracts what it used and returns true when it is done. 'uploadProgress' (optional)
+    // reports 0..1 while the upload is spread over several frames.
+    void Queue(const std::string &name, uint64_t weightBytes, std::function<void()> import,
+               std::function<bool(size_t &)> upload, std::function<float()> uploadProgress = std::function<float()>())
+    {
+        std::unique_ptr<Job> job(new Job());
+        job->name = name;
+        job->weight = weightBytes > 0 ? weightBytes : 1;
+        job->import = import;
+        job->upload = upload;
+        job->uploadProgress = uploadProgress;
+        totalWeight += job->weight;
+        jobs.push_back(std::move(job));
+    }
+
+    // queues a Model: imported with a deferred upload on the loader thread, uploaded from Update() and
+    // then registered in the ModelRegistry and stored in '*target'. a model the registry already has
+    // is handed out right away, and the same path queued twice is loaded once for both targets.
+    // '*target' may stay empty until Done().
+    void QueueModel(const std::string &path, ModelHandle *target, ModelLoadOptions options = ModelLoadOptions())
+    {
+        *target = ModelRegistry::Instance().Find(path);
+        if (*target)
+            return;
+        std::string key = ModelRegistry::Key(path);
+        std::unordered_map<std::string, std::shared_ptr<ModelJob>>::iterator queued = modelJobs.find(key);
+        if (queued != modelJobs.end())
+        {
+            queued->second->targets.push_back(target);
+            return;
+        }
+
+        std::shared_ptr<ModelJob> job(new ModelJob());
+        job->targets.push_back(target);
+        modelJobs[key] = job;
+        options.deferUpload = true;
+        Queue(path, SourceBytes(path),
+            [path, job, options]() { job->model = new Model(path, options); },
+            [path, job](size_t &budget) {
+                if (!job->model->UploadStep(budget))
+                    return false;
+                ModelHandle handle = ModelRegistry::Instance().Register(path, job->model);
+                job->model = nullptr;
+                for (size_t i = 0; i < job->targets.size(); i++)
+                    *job->targets[i] = handle;
+                return true;
+            },
+            [job]() { return job->model ? job->model->UploadProgress() : 1.0f; });
+    }
+
+    // bytes on disk of a model and the companion files its importer reads
+    static uint64_t SourceBytes(const std::string &path)
+    {
+        uint64_t bytes = 0;
+        std::vector<std::string> files = MeshCache::Dependencies(path);
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            FileStamp stamp;
+            if (GetAssetStamp(files[i], stamp))
+                bytes += stamp.size;
+        }
+        return bytes;
+    }
+
+    // starts importing the queued jobs on the workers. no jobs can be queued after this.
+    void Start()
+    {
+        size_t count = std::min<size_t>(maxWorkers, jobs.size());
+        for (size_t i = 0; i < count; i++)
+        {
+            workers.push_back(std::thread([this]() {
+                // claimed in queue order, so the job the GL thread uploads next is never the last started
+                for (size_t next = nextImport.fetch_add(1); next < jobs.size(); next = nextImport.fetch_add(1))
+                {
+                    jobs[next]->import();
+                    jobs[next]->imported.store(true, std::memory_order_release);
+                }
+            }));
+        }
+    }
+
+    // runs pending uploads of imported jobs, in queue order, until 'uploadBudget' bytes were sent. GL thread only.
+    void Update(size_t uploadBudget)
+    {
+        while (nextUpload < jobs.size())
+        {
+            Job &job = *jobs[nextUpload];
+            if (!job.imported.load(std::memory_order_acquire))
+                return;
+            if (!job.upload(uploadBudget))
+                return;
+            job.uploaded = true;
+            nextUpload++;
+            if (uploadBudget == 0)
+                return;
+        }
+        joinWorkers();
+    }
+
+    bool Done() const { return nextUpload == jobs.size(); }
+
+    // 0..1, weighted by the bytes of every job
+    float Progress() const
+    {
+        if (jobs.empty())
+            return 1.0f;
+        double done = 0.0;
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            const Job &job = *jobs[i];
+            if (job.uploaded)
+                done += (double)job.weight;
+            else if (job.imported.load(std::memory_order_acquire))
+            {
+                float upload = job.uploadProgress ? job.uploadProgress() : 0.0f;
+                done += (double)job.weight * (IMPORT_SHARE + (1.0f - IMPORT_SHARE) * upload);
+            }
+        }
+        return (float)(done / (double)totalWeight);
+    }
+
+    // name of the job currently being uploaded or waited for, for the loading screen
+    std::string CurrentJob() const
+    {
+        return nextUpload < jobs.size() ? jobs[nextUpload]->name : std::string();
+    }
+
+private:
+    struct Job {
+        std::string name;
+        uint64_t weight = 1;
+        std::function<void()> import;
+        std::function<bool(size_t &)> upload;
+        std::function<float()> uploadProgress;
+        std::atomic<bool> imported{ false };
+        bool uploaded = false;
+    };
+
+    // a model being loaded and everyone waiting for it
+    struct ModelJob {
+        Model *model = nullptr;
+        std::vector<ModelHandle *> targets;
+    };
+
+    std::vector<std::unique_ptr<Job>> jobs;
+    std::unordered_map<std::string, std::shared_ptr<ModelJob>> modelJobs;   // by ModelRegistry::Key
+    uint64_t totalWeight = 0;
+    size_t nextUpload = 0;
+    unsigned int maxWorkers;
+    std::atomic<size_t> nextImport{ 0 };
+    std::vector<std::thread> workers;
+
+    void joinWorkers()
+    {
+        for (size_t i = 0; i < workers.size(); i++)
+            if (workers[i].joinable())
+                workers[i].join();
+        workers.clear();
+    }
+};
+#endif
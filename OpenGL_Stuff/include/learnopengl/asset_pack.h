@@ -0,0 +1,323 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <learnopengl/mapped_file.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Asset pack: the game's loose files (models, textures, shaders, audio) in one file, so startup maps
+// a single file instead of opening hundreds and reads it front to back.
+//
+//     AssetPackHeader
+//     file data, each file starting on ASSET_PACK_ALIGNMENT, in path order (a model's files end up
+//     next to each other)
+//     AssetPackEntry table, sorted by hash
+//     entry names
+//
+// Files are found by the FNV-1a hash of their normalized relative path (AssetPack::Key) and the
+// name is compared to rule out collisions. Each entry keeps the size and modification time the
+// source file had when it was packed, so the mesh and texture caches built from it stay valid.
+// The packer is OpenGL/AssetPacker.cpp.
+
+const char ASSET_PACK_MAGIC[4] = { 'A', 'P', 'A', 'K' };
+const uint32_t ASSET_PACK_VERSION = 1;
+const uint64_t ASSET_PACK_ALIGNMENT = 16;
+
+#pragma pack(push, 1)
+struct AssetPackHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t entryOffset;
+    uint64_t nameOffset;
+};
+
+struct AssetPackEntry {
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t size;
+    int64_t  mtime;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+};
+#pragma pack(pop)
+
+// a file to put in a pack: 'name' is the path it is looked up by, 'path' where it is read from now
+struct AssetPackSource {
+    std::string name;
+    std::string path;
+};
+
+class AssetPack
+{
+public:
+    AssetPack() {}
+    AssetPack(const AssetPack &) = delete;
+    AssetPack &operator=(const AssetPack &) = delete;
+
+    // the name a path is looked up by: '/' separators, "." and ".." folded, lowercase (the files
+    // come from Windows, where case doesn't matter)
+    static std::string Key(const std::string &path)
+    {
+        std::vector<std::string> parts;
+        std::string part;
+        for (size_t i = 0; i <= path.size(); i++)
+        {
+            char c = i < path.size() ? path[i] : '/';
+            if (c == '/' || c == '\\')
+            {
+                if (part == ".." && !parts.empty() && parts.back() != "..")
+                    parts.pop_back();
+                else if (!part.empty() && part != ".")
+                    parts.push_back(part);
+                part.clear();
+            }
+            else
+                part += (char)tolower((unsigned char)c);
+        }
+        std::string key;
+        for (size_t i = 0; i < parts.size(); i++)
+            key += (i ? "/" : "") + parts[i];
+        return key;
+    }
+
+    static uint64_t Hash(const std::string &key)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < key.size(); i++)
+        {
+            hash ^= (unsigned char)key[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // maps 'path' and checks its header and table. returns false (and keeps nothing open) if it isn't a valid pack.
+    bool open(const std::string &path)
+    {
+        close();
+        if (!file.open(path) || file.size() < sizeof(AssetPackHeader))
+            return fail();
+        const AssetPackHeader *header = (const AssetPackHeader *)file.data();
+        if (memcmp(header->magic, ASSET_PACK_MAGIC, 4) != 0 || header->version != ASSET_PACK_VERSION)
+            return fail();
+        if (header->entryOffset > file.size() || header->nameOffset > file.size() ||
+            (uint64_t)header->entryCount * sizeof(AssetPackEntry) > file.size() - header->entryOffset)
+            return fail();
+        entries = (const AssetPackEntry *)(file.data() + header->entryOffset);
+        entryCount = header->entryCount;
+        names = (const char *)file.data() + header->nameOffset;
+        namesSize = (size_t)(file.size() - header->nameOffset);
+        for (size_t i = 0; i < entryCount; i++)
+        {
+            if (entries[i].offset + entries[i].size > file.size() || (uint64_t)entries[i].nameOffset + entries[i].nameLength > namesSize)
+                return fail();
+        }
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        entries = nullptr;
+        entryCount = 0;
+        names = nullptr;
+        namesSize = 0;
+    }
+
+    bool isOpen() const { return file.isOpen(); }
+    size_t FileCount() const { return entryCount; }
+    size_t size() const { return file.size(); }
+
+    // the entry of 'path', or null if the pack doesn't have it
+    const AssetPackEntry *Find(const std::string &path) const
+    {
+        if (!entries)
+            return nullptr;
+        std::string key = Key(path);
+        uint64_t hash = Hash(key);
+        const AssetPackEntry *end = entries + entryCount;
+        const AssetPackEntry *it = std::lower_bound(entries, end, hash,
+            [](const AssetPackEntry &entry, uint64_t value) { return entry.hash < value; });
+        for (; it != end && it->hash == hash; ++it)
+        {
+            if (it->nameLength == key.size() && memcmp(names + it->nameOffset, key.data(), key.size()) == 0)
+                return it;
+        }
+        return nullptr;
+    }
+
+    const unsigned char *Data(const AssetPackEntry &entry) const
+    {
+        return file.data() + entry.offset;
+    }
+
+    // writes 'sources' into a new pack at 'path'. returns false if a source can't be read or the
+    // pack can't be written.
+    static bool Write(const std::string &path, std::vector<AssetPackSource> sources)
+    {
+        std::sort(sources.begin(), sources.end(), [](const AssetPackSource &a, const AssetPackSource &b) { return Key(a.name) < Key(b.name); });
+        std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        AssetPackHeader header;
+        memset(&header, 0, sizeof(header));
+        out.write((const char *)&header, sizeof(header));
+
+        std::vector<AssetPackEntry> table;
+        std::string nameBlock;
+        std::vector<char> contents;
+        uint64_t offset = sizeof(header);
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            FileStamp stamp;
+            std::ifstream in(sources[i].path.c_str(), std::ios::binary);
+            if (!in || !GetFileStamp(sources[i].path, stamp))
+            {
+                std::cout << "ASSET_PACK:: can't read " << sources[i].path << std::endl;
+                return false;
+            }
+            contents.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            offset = padTo(out, offset);
+
+            std::string key = Key(sources[i].name);
+            AssetPackEntry entry;
+            entry.hash = Hash(key);
+            entry.offset = offset;
+            entry.size = contents.size();
+            entry.mtime = stamp.mtime;
+            entry.nameOffset = (uint32_t)nameBlock.size();
+            entry.nameLength = (uint32_t)key.size();
+            table.push_back(entry);
+            nameBlock += key;
+
+            if (!contents.empty())
+                out.write(&contents[0], (std::streamsize)contents.size());
+            offset += contents.size();
+        }
+        std::stable_sort(table.begin(), table.end(), [](const AssetPackEntry &a, const AssetPackEntry &b) { return a.hash < b.hash; });
+
+        offset = padTo(out, offset);
+        memcpy(header.magic, ASSET_PACK_MAGIC, 4);
+        header.version = ASSET_PACK_VERSION;
+        header.entryCount = (uint32_t)table.size();
+        header.entryOffset = offset;
+        header.nameOffset = offset + table.size() * sizeof(AssetPackEntry);
+        if (!table.empty())
+            out.write((const char *)&table[0], (std::streamsize)(table.size() * sizeof(AssetPackEntry)));
+        out.write(nameBlock.data(), (std::streamsize)nameBlock.size());
+        out.seekp(0);
+        out.write((const char *)&header, sizeof(header));
+        return (bool)out;
+    }
+
+private:
+    MappedFile file;
+    const AssetPackEntry *entries = nullptr;
+    size_t entryCount = 0;
+    const char *names = nullptr;
+    size_t namesSize = 0;
+
+    bool fail()
+    {
+        close();
+        return false;
+    }
+
+    static uint64_t padTo(std::ofstream &out, uint64_t offset)
+    {
+        static const char zeros[ASSET_PACK_ALIGNMENT] = {};
+        uint64_t aligned = (offset + ASSET_PACK_ALIGNMENT - 1) & ~(ASSET_PACK_ALIGNMENT - 1);
+        out.write(zeros, (std::streamsize)(aligned - offset));
+        return aligned;
+    }
+};
+
+// the pack the loaders read from. mount it once at startup, before anything is loaded: lookups
+// don't lock, so it must not change while loads run.
+inline AssetPack &MountedAssetPack()
+{
+    static AssetPack pack;
+    return pack;
+}
+
+inline bool MountAssetPack(const std::string &path)
+{
+    if (!MountedAssetPack().open(path))
+        return false;
+    std::cout << "ASSET_PACK:: mounted " << path << " (" << MountedAssetPack().FileCount() << " files)" << std::endl;
+    return true;
+}
+
+// size and modification time of an asset: from the mounted pack if it has the file, from disk otherwise
+inline bool GetAssetStamp(const std::string &path, FileStamp &stamp)
+{
+    const AssetPackEntry *entry = MountedAssetPack().Find(path);
+    if (!entry)
+        return GetFileStamp(path, stamp);
+    stamp.size = entry->size;
+    stamp.mtime = entry->mtime;
+    return true;
+}
+
+// read-only view of an asset's bytes: inside the mounted pack when it has the file, otherwise the
+// loose file is mapped. the view stays valid until close() or destruction.
+class AssetFile
+{
+public:
+    AssetFile() {}
+    explicit AssetFile(const std::string &path) { open(path); }
+
+    AssetFile(const AssetFile &) = delete;
+    AssetFile &operator=(const AssetFile &) = delete;
+
+    bool open(const std::string &path)
+    {
+        close();
+        const AssetPackEntry *entry = MountedAssetPack().Find(path);
+        if (entry)
+        {
+            view = MountedAssetPack().Data(*entry);
+            length = (size_t)entry->size;
+            packed = true;
+            return true;
+        }
+        if (!file.open(path))
+            return false;
+        view = file.data();
+        length = file.size();
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        view = nullptr;
+        length = 0;
+        packed = false;
+    }
+
+    bool isOpen() const { return view != nullptr; }
+    const unsigned char *data() const { return view; }
+    size_t size() const { return length; }
+    bool isPacked() const { return packed; }
+
+    std::string text() const { return view ? std::string((const char *)view, length) : std::string(); }
+
+private:
+    MappedFile file;
+    const unsigned char *view = nullptr;
+    size_t length = 0;
+    bool packed = false;
+};
+#endif
@@ -0,0 +1,34 @@
+#ifndef ASSET_PACK_IO_H
+#define ASSET_PACK_IO_H
+
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/MemoryIOWrapper.h>
+
+#include <learnopengl/asset_pack.h>
+
+// Assimp file system over the mounted asset pack: the model and the files it pulls in (.mtl, .bin)
+// are read straight from the mapping, anything the pack doesn't have from disk as usual.
+// give it to an importer with importer.SetIOHandler(new AssetPackIOSystem()); the importer owns it.
+class AssetPackIOSystem : public Assimp::DefaultIOSystem
+{
+public:
+    bool Exists(const char *pFile) const override
+    {
+        return MountedAssetPack().Find(pFile) != nullptr || Assimp::DefaultIOSystem::Exists(pFile);
+    }
+
+    Assimp::IOStream *Open(const char *pFile, const char *pMode = "rb") override
+    {
+        const AssetPackEntry *entry = MountedAssetPack().Find(pFile);
+        if (!entry || strchr(pMode, 'w') || strchr(pMode, 'a'))
+            return Assimp::DefaultIOSystem::Open(pFile, pMode);
+        // the stream doesn't own the bytes, they stay in the pack
+        return new Assimp::MemoryIOStream(MountedAssetPack().Data(*entry), (size_t)entry->size);
+    }
+
+    void Close(Assimp::IOStream *pFile) override
+    {
+        delete pFile;
+    }
+};
+#endif
@@ -0,0 +1,82 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// The six planes of a view frustum, taken from a projection * view matrix (Gribb & Hartmann), to
+// reject what can't be on screen before it is drawn. Plane normals point inside and are
+// normalized, so a plane gives the signed distance of a point. The tests are conservative: a
+// volume is only rejected when it is entirely behind one plane. A default Frustum has zero planes
+// and contains everything.
+struct Frustum {
+    glm::vec4 planes[6];   // left, right, bottom, top, near, far: inside where dot(plane, (p, 1)) >= 0
+
+    Frustum()
+    {
+        for (int i = 0; i < 6; i++)
+            planes[i] = glm::vec4(0.0f);
+    }
+
+    // for world space tests pass projection * view; with projection alone the tests are in view space
+    explicit Frustum(const glm::mat4 &viewProjection)
+    {
+        // rows of the matrix (glm is column-major)
+        glm::vec4 row[4];
+        for (int r = 0; r < 4; r++)
+            row[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+        planes[0] = row[3] + row[0];
+        planes[1] = row[3] - row[0];
+        planes[2] = row[3] + row[1];
+        planes[3] = row[3] - row[1];
+        planes[4] = row[3] + row[2];
+        planes[5] = row[3] - row[2];
+        for (int i = 0; i < 6; i++)
+        {
+            float length = glm::length(glm::vec3(planes[i]));
+            if (length > 0.0f)
+                planes[i] /= length;
+        }
+    }
+
+    bool IntersectsSphere(const glm::vec3 &centre, float radius) const
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            if (glm::dot(glm::vec3(planes[i]), centre) + planes[i].w < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    // axis-aligned box given by its centre and half size
+    bool IntersectsBox(const glm::vec3 &centre, const glm::vec3 &extent) const
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            glm::vec3 normal = glm::vec3(planes[i]);
+            // how far the box reaches along the normal
+            float reach = glm::dot(glm::abs(normal), extent);
+            if (glm::dot(normal, centre) + planes[i].w < -reach)
+                return false;
+        }
+        return true;
+    }
+
+    // object space bounds (box and bounding sphere) placed with 'modelMatrix': the sphere test is
+    // cheap and rejects most, the box (as the world box around the transformed one) is tighter
+    bool IntersectsBounds(const glm::mat4 &modelMatrix, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                          const glm::vec3 &sphereCentre, float sphereRadius) const
+    {
+        glm::mat3 linear = glm::mat3(modelMatrix);
+        float scale = glm::max(glm::length(linear[0]), glm::max(glm::length(linear[1]), glm::length(linear[2])));
+        glm::vec3 centre = glm::vec3(modelMatrix * glm::vec4(sphereCentre, 1.0f));
+        if (!IntersectsSphere(centre, sphereRadius * scale))
+            return false;
+
+        glm::vec3 boxCentre = glm::vec3(modelMatrix * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        glm::vec3 halfSize = (boundsMax - boundsMin) * 0.5f;
+        glm::vec3 extent = glm::abs(linear[0]) * halfSize.x + glm::abs(linear[1]) * halfSize.y + glm::abs(linear[2]) * halfSize.z;
+        return IntersectsBox(boxCentre, extent);
+    }
+};
+#endif
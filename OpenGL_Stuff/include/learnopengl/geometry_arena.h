@@ -0,0 +1,250 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// a contiguous range of vertices and indices inside one page of a GeometryPool.
+// indices are relative to 'baseVertex', so they are stored exactly as the mesh produced them.
+struct GeometryAllocation {
+    int          page = -1;        // -1 when nothing is allocated
+    unsigned int baseVertex = 0;   // first vertex of the range in the page's VBO
+    unsigned int vertexCount = 0;
+    unsigned int firstIndex = 0;   // first index of the range in the page's EBO
+    unsigned int indexCount = 0;
+
+    bool valid() const { return page >= 0; }
+};
+
+// Large shared vertex/index buffers for every mesh that uses one vertex format and index type.
+// Each page owns a VBO, an EBO and the single VAO that describes the format over them, so meshes
+// in the same page draw with glDrawElementsBaseVertex without rebinding any buffer. Ranges are
+// handed out first-fit from a free list and merged back when released; a mesh that doesn't fit
+// in any page gets a new one (sized for it if it is bigger than the default page).
+// The GL objects are not deleted by the destructor, which may run after the context is gone:
+// call clear() on the GL thread before tearing the context down.
+class GeometryPool
+{
+public:
+    // enables the attributes of the format; called with the page's VAO and VBO bound
+    typedef void (*AttributeSetup)();
+
+    // 'indexType' is GL_UNSIGNED_INT or GL_UNSIGNED_SHORT
+    GeometryPool(size_t vertexStride, AttributeSetup setup, GLenum indexType = GL_UNSIGNED_INT,
+                 unsigned int pageVertices = 256 * 1024, unsigned int pageIndices = 1024 * 1024)
+        : stride(vertexStride), setupAttributes(setup), type(indexType),
+          indexSize(indexType == GL_UNSIGNED_SHORT ? 2 : 4), defaultPageVertices(pageVertices), defaultPageIndices(pageIndices)
+    {
+    }
+
+    GeometryPool(const GeometryPool &) = delete;
+    GeometryPool &operator=(const GeometryPool &) = delete;
+
+    // copies 'vertexCount' vertices ('stride' bytes each) and 'indexCount' indices of the pool's index
+    // type into the pool. must run on the GL thread.
+    GeometryAllocation Allocate(const void *vertices, unsigned int vertexCount, const void *indices, unsigned int indexCount)
+    {
+        GeometryAllocation allocation;
+        allocation.vertexCount = vertexCount;
+        allocation.indexCount = indexCount;
+        for (size_t i = 0; i < pages.size() && !allocation.valid(); i++)
+        {
+            Page &page = *pages[i];
+            size_t vertexBlock = findRange(page.freeVertices, vertexCount);
+            size_t indexBlock = findRange(page.freeIndices, indexCount);
+            if (vertexBlock == NOT_FOUND || indexBlock == NOT_FOUND)
+                continue;
+            allocation.page = (int)i;
+            allocation.baseVertex = takeRange(page.freeVertices, vertexBlock, vertexCount);
+            allocation.firstIndex = takeRange(page.freeIndices, indexBlock, indexCount);
+        }
+        if (!allocation.valid())
+        {
+            addPage(std::max(vertexCount, defaultPageVertices), std::max(indexCount, defaultPageIndices));
+            Page &page = *pages.back();
+            allocation.page = (int)pages.size() - 1;
+            allocation.baseVertex = takeRange(page.freeVertices, 0, vertexCount);
+            allocation.firstIndex = takeRange(page.freeIndices, 0, indexCount);
+        }
+
+        Page &page = *pages[allocation.page];
+        if (vertexCount > 0)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, page.VBO);
+            glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)allocation.baseVertex * stride, (GLsizeiptr)vertexCount * stride, vertices);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        if (indexCount > 0)
+        {
+            // the element buffer binding is VAO state, so write it through the page's own VAO
+            glBindVertexArray(page.VAO);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)allocation.firstIndex * indexSize, (GLsizeiptr)indexCount * indexSize, indices);
+            glBindVertexArray(0);
+        }
+        page.usedVertices += vertexCount;
+        page.usedIndices += indexCount;
+        return allocation;
+    }
+
+    // gives the range back to its page; the buffers themselves are only freed by clear()
+    void Release(GeometryAllocation &allocation)
+    {
+        if (!allocation.valid() || allocation.page >= (int)pages.size())
+            return;
+        Page &page = *pages[allocation.page];
+        giveRange(page.freeVertices, allocation.baseVertex, allocation.vertexCount);
+        giveRange(page.freeIndices, allocation.firstIndex, allocation.indexCount);
+        page.usedVertices -= allocation.vertexCount;
+        page.usedIndices -= allocation.indexCount;
+        allocation = GeometryAllocation();
+    }
+
+    unsigned int VertexArray(int page) const { return pages[page]->VAO; }
+
+    // draws a whole allocation; the page's VAO must be bound
+    void DrawElements(const GeometryAllocation &allocation) const
+    {
+        DrawRange(allocation, 0, allocation.indexCount);
+    }
+
+    // draws 'count' indices starting 'first' indices into the allocation
+    void DrawRange(const GeometryAllocation &allocation, unsigned int first, unsigned int count) const
+    {
+        glDrawElementsBaseVertex(GL_TRIANGLES, count, type,
+                                 (void*)((size_t)(allocation.firstIndex + first) * indexSize), allocation.baseVertex);
+    }
+
+    // the same range 'instances' times in one call, for a VAO with per-instance attributes
+    void DrawRangeInstanced(const GeometryAllocation &allocation, unsigned int first, unsigned int count, unsigned int instances) const
+    {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, count, type,
+                                          (void*)((size_t)(allocation.firstIndex + first) * indexSize), instances, allocation.baseVertex);
+    }
+
+    size_t VertexStride() const { return stride; }
+    size_t IndexSize() const { return indexSize; }
+
+    size_t PageCount() const { return pages.size(); }
+
+    // bytes of VRAM reserved by the pages / actually holding geometry
+    size_t ReservedBytes() const
+    {
+        size_t bytes = 0;
+        for (size_t i = 0; i < pages.size(); i++)
+            bytes += (size_t)pages[i]->vertexCapacity * stride + (size_t)pages[i]->indexCapacity * indexSize;
+        return bytes;
+    }
+
+    size_t UsedBytes() const
+    {
+        size_t bytes = 0;
+        for (size_t i = 0; i < pages.size(); i++)
+            bytes += (size_t)pages[i]->usedVertices * stride + (size_t)pages[i]->usedIndices * indexSize;
+        return bytes;
+    }
+
+    // deletes every page. allocations handed out before become invalid. must run on the GL thread.
+    void clear()
+    {
+        for (size_t i = 0; i < pages.size(); i++)
+        {
+            glDeleteVertexArrays(1, &pages[i]->VAO);
+            glDeleteBuffers(1, &pages[i]->VBO);
+            glDeleteBuffers(1, &pages[i]->EBO);
+        }
+        pages.clear();
+    }
+
+private:
+    struct Range {
+        unsigned int first;
+        unsigned int count;
+    };
+
+    struct Page {
+        unsigned int VAO = 0, VBO = 0, EBO = 0;
+        unsigned int vertexCapacity = 0, indexCapacity = 0;
+        unsigned int usedVertices = 0, usedIndices = 0;
+        std::vector<Range> freeVertices;   // sorted by 'first', never adjacent
+        std::vector<Range> freeIndices;
+    };
+
+    static const size_t NOT_FOUND = (size_t)-1;
+
+    size_t stride;
+    AttributeSetup setupAttributes;
+    GLenum type;
+    size_t indexSize;
+    unsigned int defaultPageVertices;
+    unsigned int defaultPageIndices;
+    std::vector<std::unique_ptr<Page>> pages;
+
+    void addPage(unsigned int vertexCapacity, unsigned int indexCapacity)
+    {
+        std::unique_ptr<Page> page(new Page());
+        page->vertexCapacity = vertexCapacity;
+        page->indexCapacity = indexCapacity;
+        page->freeVertices.push_back(Range{ 0, vertexCapacity });
+        page->freeIndices.push_back(Range{ 0, indexCapacity });
+
+        glGenVertexArrays(1, &page->VAO);
+        glGenBuffers(1, &page->VBO);
+        glGenBuffers(1, &page->EBO);
+
+        glBindVertexArray(page->VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, page->VBO);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCapacity * stride, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, page->EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCapacity * indexSize, NULL, GL_STATIC_DRAW);
+        setupAttributes();
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        pages.push_back(std::move(page));
+    }
+
+    // first free block that can hold 'count' elements
+    static size_t findRange(const std::vector<Range> &ranges, unsigned int count)
+    {
+        for (size_t i = 0; i < ranges.size(); i++)
+            if (ranges[i].count >= count)
+                return i;
+        return NOT_FOUND;
+    }
+
+    static unsigned int takeRange(std::vector<Range> &ranges, size_t block, unsigned int count)
+    {
+        unsigned int first = ranges[block].first;
+        ranges[block].first += count;
+        ranges[block].count -= count;
+        if (ranges[block].count == 0)
+            ranges.erase(ranges.begin() + block);
+        return first;
+    }
+
+    // inserts [first, first + count) back in order and merges it with its neighbours
+    static void giveRange(std::vector<Range> &ranges, unsigned int first, unsigned int count)
+    {
+        if (count == 0)
+            return;
+        size_t i = 0;
+        while (i < ranges.size() && ranges[i].first < first)
+            i++;
+        ranges.insert(ranges.begin() + i, Range{ first, count });
+        if (i + 1 < ranges.size() && ranges[i].first + ranges[i].count == ranges[i + 1].first)
+        {
+            ranges[i].count += ranges[i + 1].count;
+            ranges.erase(ranges.begin() + i + 1);
+        }
+        if (i > 0 && ranges[i - 1].first + ranges[i - 1].count == ranges[i].first)
+        {
+            ranges[i - 1].count += ranges[i].count;
+            ranges.erase(ranges.begin() + i);
+        }
+    }
+};
+#endif
@@ -0,0 +1,686 @@
+#ifndef GLTF_LOADER_H
+#define GLTF_LOADER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/load_profiler.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/mesh.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Direct glTF 2.0 import for Model: the .gltf JSON is parsed here and the .bin buffers are
+// memory-mapped, so accessors are converted straight into Vertex / index arrays without an
+// aiScene in between (32-bit index accessors are copied as they are). The result matches what
+// Model gets from Assimp with MODEL_IMPORT_FLAGS: one mesh per primitive in node order, node
+// transforms ignored, glTF uvs unflipped (Assimp's flip on import and aiProcess_FlipUVs cancel
+// out), tangents from TANGENT or computed, smooth normals when NORMAL is missing.
+// Anything it doesn't cover (embedded or data: buffers, non-triangle primitives, sparse
+// accessors, required extensions) makes LoadGltf() fail, and the caller uses Assimp instead.
+
+// one glTF primitive, ready to become a Mesh
+struct GltfPrimitive {
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::string diffuseTexture;    // image uri relative to the .gltf, empty if none
+    std::string specularTexture;
+};
+
+namespace gltf_detail
+{
+    // just enough JSON for glTF: numbers are doubles, objects keep their members in order
+    struct JsonValue {
+        enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+        Type type = NUL;
+        bool boolean = false;
+        double number = 0.0;
+        std::string text;
+        std::vector<std::string> keys;     // OBJECT member names
+        std::vector<JsonValue> items;      // ARRAY elements / OBJECT member values
+
+        static const JsonValue &null()
+        {
+            static JsonValue value;
+            return value;
+        }
+
+        // member 'key' of an object; null if missing
+        const JsonValue &operator[](const char *key) const
+        {
+            if (type == OBJECT)
+                for (size_t i = 0; i < keys.size(); i++)
+                    if (keys[i] == key)
+                        return items[i];
+            return null();
+        }
+
+        // element 'index' of an array; null if out of range
+        const JsonValue &operator[](size_t index) const
+        {
+            return type == ARRAY && index < items.size() ? items[index] : null();
+        }
+
+        bool has(const char *key) const { return (*this)[key].type != NUL; }
+        size_t size() const { return type == ARRAY ? items.size() : 0; }
+        int asInt(int fallback = -1) const { return type == NUMBER ? (int)number : fallback; }
+        size_t asSize(size_t fallback = 0) const { return type == NUMBER && number >= 0 ? (size_t)number : fallback; }
+        bool asBool(bool fallback = false) const { return type == BOOLEAN ? boolean : fallback; }
+    };
+
+    class JsonParser
+    {
+    public:
+        JsonParser(const char *text, size_t length) : cursor(text), end(text + length) {}
+
+        bool parse(JsonValue &value)
+        {
+            return parseValue(value, 0) && (skipSpace(), cursor == end);
+        }
+
+    private:
+        const char *cursor;
+        const char *end;
+
+        void skipSpace()
+        {
+            while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r'))
+                cursor++;
+        }
+
+        bool literal(const char *word)
+        {
+            size_t length = strlen(word);
+            if ((size_t)(end - cursor) < length || strncmp(cursor, word, length) != 0)
+                return false;
+            cursor += length;
+            return true;
+        }
+
+        bool parseValue(JsonValue &value, int depth)
+        {
+            if (depth > 64)
+                return false;
+            skipSpace();
+            if (cursor >= end)
+                return false;
+            switch (*cursor)
+            {
+            case '{': return parseObject(value, depth);
+            case '[': return parseArray(value, depth);
+            case '"': value.type = JsonValue::STRING; return parseString(value.text);
+            case 't': value.type = JsonValue::BOOLEAN; value.boolean = true; return literal("true");
+            case 'f': value.type = JsonValue::BOOLEAN; value.boolean = false; return literal("false");
+            case 'n': value.type = JsonValue::NUL; return literal("null");
+            default:  return parseNumber(value);
+            }
+        }
+
+        bool parseObject(JsonValue &value, int depth)
+        {
+            value.type = JsonValue::OBJECT;
+            cursor++;
+            skipSpace();
+            if (cursor < end && *cursor == '}')
+            {
+                cursor++;
+                return true;
+            }
+            for (;;)
+            {
+                skipSpace();
+                std::string key;
+                if (cursor >= end || *cursor != '"' || !parseString(key))
+                    return false;
+                skipSpace();
+                if (cursor >= end || *cursor++ != ':')
+                    return false;
+                value.keys.push_back(key);
+                value.items.push_back(JsonValue());
+                if (!parseValue(value.items.back(), depth + 1))
+                    return false;
+                skipSpace();
+                if (cursor >= end)
+                    return false;
+                if (*cursor == '}')
+                {
+                    cursor++;
+                    return true;
+                }
+                if (*cursor++ != ',')
+                    return false;
+            }
+        }
+
+        bool parseArray(JsonValue &value, int depth)
+        {
+            value.type = JsonValue::ARRAY;
+            cursor++;
+            skipSpace();
+            if (cursor < end && *cursor == ']')
+            {
+                cursor++;
+                return true;
+            }
+            for (;;)
+            {
+                value.items.push_back(JsonValue());
+                if (!parseValue(value.items.back(), depth + 1))
+                    return false;
+                skipSpace();
+                if (cursor >= end)
+                    return false;
+                if (*cursor == ']')
+                {
+                    cursor++;
+                    return true;
+                }
+                if (*cursor++ != ',')
+                    return false;
+            }
+        }
+
+        static void appendUtf8(std::string &out, unsigned int code)
+        {
+            if (code < 0x80)
+                out += (char)code;
+            else if (code < 0x800)
+            {
+                out += (char)(0xC0 | (code >> 6));
+                out += (char)(0x80 | (code & 0x3F));
+            }
+            else
+            {
+                out += (char)(0xE0 | (code >> 12));
+                out += (char)(0x80 | ((code >> 6) & 0x3F));
+                out += (char)(0x80 | (code & 0x3F));
+            }
+        }
+
+        bool parseString(std::string &out)
+        {
+            cursor++;
+            while (cursor < end && *cursor != '"')
+            {
+                char c = *cursor++;
+                if (c != '\\')
+                {
+                    out += c;
+                    continue;
+                }
+                if (cursor >= end)
+                    return false;
+                char escape = *cursor++;
+                switch (escape)
+                {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u':
+                {
+                    if (end - cursor < 4)
+                        return false;
+                    std::string hex(cursor, cursor + 4);
+                    cursor += 4;
+                    appendUtf8(out, (unsigned int)strtoul(hex.c_str(), NULL, 16));
+                    break;
+                }
+                default: out += escape; break;
+                }
+            }
+            if (cursor >= end)
+                return false;
+            cursor++;
+            return true;
+        }
+
+        bool parseNumber(JsonValue &value)
+        {
+            const char *start = cursor;
+            while (cursor < end && (isdigit((unsigned char)*cursor) || *cursor == '-' || *cursor == '+' ||
+                                    *cursor == '.' || *cursor == 'e' || *cursor == 'E'))
+                cursor++;
+            if (cursor == start)
+                return false;
+            value.type = JsonValue::NUMBER;
+            value.number = strtod(std::string(start, cursor).c_str(), NULL);
+            return true;
+        }
+    };
+
+    // glTF component types
+    const int GLTF_BYTE = 5120, GLTF_UNSIGNED_BYTE = 5121, GLTF_SHORT = 5122, GLTF_UNSIGNED_SHORT = 5123;
+    const int GLTF_UNSIGNED_INT = 5125, GLTF_FLOAT = 5126;
+    const int GLTF_TRIANGLES = 4;
+
+    inline size_t componentSize(int componentType)
+    {
+        switch (componentType)
+        {
+        case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: return 1;
+        case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: return 2;
+        case GLTF_UNSIGNED_INT: case GLTF_FLOAT: return 4;
+        default: return 0;
+        }
+    }
+
+    inline int componentCount(const std::string &type)
+    {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        return 0;
+    }
+
+    // an accessor resolved to memory inside a mapped buffer
+    struct Accessor {
+        const unsigned char *data = nullptr;
+        size_t stride = 0;
+        size_t count = 0;
+        int componentType = 0;
+        int components = 0;
+        bool normalized = false;
+
+        // component 'c' of element 'i' as a float, normalized integers scaled to 0..1 / -1..1
+        float get(size_t i, int c) const
+        {
+            const unsigned char *p = data + i * stride + c * componentSize(componentType);
+            switch (componentType)
+            {
+            case GLTF_FLOAT:          { float v; memcpy(&v, p, 4); return v; }
+            case GLTF_UNSIGNED_BYTE:  return normalized ? *p / 255.0f : (float)*p;
+            case GLTF_BYTE:           return normalized ? glm::max((signed char)*p / 127.0f, -1.0f) : (float)(signed char)*p;
+            case GLTF_UNSIGNED_SHORT: { uint16_t v; memcpy(&v, p, 2); return normalized ? v / 65535.0f : (float)v; }
+            case GLTF_SHORT:          { int16_t v; memcpy(&v, p, 2); return normalized ? glm::max(v / 32767.0f, -1.0f) : (float)v; }
+            default:                  { uint32_t v; memcpy(&v, p, 4); return (float)v; }
+            }
+        }
+
+        unsigned int index(size_t i) const
+        {
+            const unsigned char *p = data + i * stride;
+            if (componentType == GLTF_UNSIGNED_BYTE)
+                return *p;
+            if (componentType == GLTF_UNSIGNED_SHORT)
+            {
+                uint16_t v;
+                memcpy(&v, p, 2);
+                return v;
+            }
+            uint32_t v;
+            memcpy(&v, p, 4);
+            return v;
+        }
+    };
+
+    // a parsed .gltf with its buffers mapped (or found in the asset pack)
+    struct Document {
+        JsonValue json;
+        std::vector<std::unique_ptr<AssetFile>> buffers;
+        std::string error;
+        unsigned int attributes = VERTEX_ATTRIBS_ALL;   // what the caller needs, the rest is left zero
+
+        bool fail(const std::string &message)
+        {
+            error = message;
+            return false;
+        }
+
+        bool accessor(int index, Accessor &out)
+        {
+            const JsonValue &a = json["accessors"][(size_t)index];
+            if (a.type != JsonValue::OBJECT)
+                return fail("missing accessor");
+            if (a.has("sparse"))
+                return fail("sparse accessor");
+            const JsonValue &view = json["bufferViews"][a["bufferView"].asSize((size_t)-1)];
+            if (view.type != JsonValue::OBJECT)
+                return fail("accessor without buffer view");
+            size_t buffer = view["buffer"].asSize((size_t)-1);
+            if (buffer >= buffers.size())
+                return fail("bad buffer index");
+
+            out.componentType = a["componentType"].asInt();
+            out.components = componentCount(a["type"].text);
+            out.normalized = a["normalized"].asBool();
+            out.count = a["count"].asSize();
+            size_t elementSize = componentSize(out.componentType) * out.components;
+            if (elementSize == 0)
+                return fail("unsupported accessor type");
+            out.stride = view["byteStride"].asSize(elementSize);
+            size_t offset = view["byteOffset"].asSize() + a["byteOffset"].asSize();
+            size_t viewEnd = view["byteOffset"].asSize() + view["byteLength"].asSize();
+            if (out.count > 0 && (offset + out.stride * (out.count - 1) + elementSize > viewEnd || viewEnd > buffers[buffer]->size()))
+                return fail("accessor out of bounds");
+            out.data = buffers[buffer]->data() + offset;
+            return true;
+        }
+
+        // uri of the image behind texture 'index', "" for embedded images
+        std::string textureUri(const JsonValue &textureInfo)
+        {
+            if (textureInfo.type != JsonValue::OBJECT)
+                return std::string();
+            const JsonValue &texture = json["textures"][textureInfo["index"].asSize((size_t)-1)];
+            const JsonValue &image = json["images"][texture["source"].asSize((size_t)-1)];
+            const std::string &uri = image["uri"].text;
+            if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+                return std::string();
+            return decodeUri(uri);
+        }
+
+        static std::string decodeUri(const std::string &uri)
+        {
+            std::string result;
+            for (size_t i = 0; i < uri.size(); i++)
+            {
+                if (uri[i] == '%' && i + 2 < uri.size() && isxdigit((unsigned char)uri[i + 1]) && isxdigit((unsigned char)uri[i + 2]))
+                {
+                    result += (char)strtoul(uri.substr(i + 1, 2).c_str(), NULL, 16);
+                    i += 2;
+                }
+                else
+                    result += uri[i];
+            }
+            return result;
+        }
+    };
+
+    // face normals summed on the vertices they touch, for primitives without NORMAL
+    inline void generateNormals(std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices)
+    {
+        for (size_t v = 0; v < vertices.size(); v++)
+            vertices[v].Normal = glm::vec3(0.0f);
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            Vertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]], &c = vertices[indices[i + 2]];
+            glm::vec3 n = glm::cross(b.Position - a.Position, c.Position - a.Position);
+            a.Normal += n;
+            b.Normal += n;
+            c.Normal += n;
+        }
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            float length = glm::length(vertices[v].Normal);
+            vertices[v].Normal = length > 0.0f ? vertices[v].Normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    }
+
+    // tangent space from the uv gradients of the triangles, orthogonalized against the normal
+    inline void generateTangents(std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices)
+    {
+        for (size_t v = 0; v < vertices.size(); v++)
+            vertices[v].Tangent = vertices[v].Bitangent = glm::vec3(0.0f);
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            Vertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]], &c = vertices[indices[i + 2]];
+            glm::vec3 e1 = b.Position - a.Position, e2 = c.Position - a.Position;
+            glm::vec2 d1 = b.TexCoords - a.TexCoords, d2 = c.TexCoords - a.TexCoords;
+            float det = d1.x * d2.y - d2.x * d1.y;
+            if (det == 0.0f)
+                continue;
+            float r = 1.0f / det;
+            glm::vec3 t = (e1 * d2.y - e2 * d1.y) * r;
+            glm::vec3 bt = (e2 * d1.x - e1 * d2.x) * r;
+            a.Tangent += t; b.Tangent += t; c.Tangent += t;
+            a.Bitangent += bt; b.Bitangent += bt; c.Bitangent += bt;
+        }
+        for (size_t v = 0; v < vertices.size(); v++)
+        {
+            Vertex &vertex = vertices[v];
+            glm::vec3 t = vertex.Tangent - vertex.Normal * glm::dot(vertex.Normal, vertex.Tangent);
+            float length = glm::length(t);
+            if (length <= 0.0f)
+                continue;
+            vertex.Tangent = t / length;
+            float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+            vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent) * handedness;
+        }
+    }
+
+    inline bool loadPrimitive(Document &doc, const JsonValue &primitive, GltfPrimitive &out)
+    {
+        if (primitive["mode"].asInt(GLTF_TRIANGLES) != GLTF_TRIANGLES)
+            return doc.fail("primitive is not a triangle list");
+        const JsonValue &attributes = primitive["attributes"];
+        Accessor positions, normals, texCoords, tangents;
+        if (!attributes.has("POSITION") || !doc.accessor(attributes["POSITION"].asInt(), positions))
+            return doc.fail("primitive without positions");
+        // a tangent frame needs the normals, generated ones included
+        bool wantTangents = (doc.attributes & VERTEX_ATTRIBS_TANGENT_FRAME) != 0;
+        bool wantNormals = (doc.attributes & VERTEX_ATTRIB_NORMAL) != 0 || wantTangents;
+        bool wantTexCoords = (doc.attributes & VERTEX_ATTRIB_TEXCOORDS) != 0 || wantTangents;
+        bool hasNormals = wantNormals && attributes.has("NORMAL") && doc.accessor(attributes["NORMAL"].asInt(), normals);
+        bool hasTexCoords = wantTexCoords && attributes.has("TEXCOORD_0") && doc.accessor(attributes["TEXCOORD_0"].asInt(), texCoords);
+        bool hasTangents = wantTangents && attributes.has("TANGENT") && doc.accessor(attributes["TANGENT"].asInt(), tangents);
+        doc.error.clear();
+        if ((hasNormals && normals.count != positions.count) || (hasTexCoords && texCoords.count != positions.count) ||
+            (hasTangents && (tangents.count != positions.count || tangents.components < 3)))
+            return doc.fail("attribute counts differ");
+
+        out.vertices.resize(positions.count);
+        for (size_t i = 0; i < positions.count; i++)
+        {
+            Vertex &vertex = out.vertices[i];
+            vertex.Position = glm::vec3(positions.get(i, 0), positions.get(i, 1), positions.get(i, 2));
+            vertex.Normal = hasNormals ? glm::vec3(normals.get(i, 0), normals.get(i, 1), normals.get(i, 2)) : glm::vec3(0.0f);
+            vertex.TexCoords = hasTexCoords ? glm::vec2(texCoords.get(i, 0), texCoords.get(i, 1)) : glm::vec2(0.0f);
+            vertex.Tangent = glm::vec3(0.0f);
+            vertex.Bitangent = glm::vec3(0.0f);
+            if (hasTangents)
+            {
+                vertex.Tangent = glm::vec3(tangents.get(i, 0), tangents.get(i, 1), tangents.get(i, 2));
+                float w = tangents.components == 4 ? tangents.get(i, 3) : 1.0f;
+                vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent) * w;
+            }
+        }
+
+        if (primitive.has("indices"))
+        {
+            Accessor indices;
+            if (!doc.accessor(primitive["indices"].asInt(), indices) || indices.components != 1)
+                return doc.fail("bad index accessor");
+            out.indices.resize(indices.count);
+            if (indices.componentType == GLTF_UNSIGNED_INT && indices.stride == 4)
+            {
+                if (indices.count > 0)
+                    memcpy(&out.indices[0], indices.data, indices.count * 4);
+            }
+            else
+            {
+                for (size_t i = 0; i < indices.count; i++)
+                    out.indices[i] = indices.index(i);
+            }
+            for (size_t i = 0; i < out.indices.size(); i++)
+                if (out.indices[i] >= out.vertices.size())
+                    return doc.fail("index out of range");
+        }
+        else
+        {
+            out.indices.resize(out.vertices.size());
+            for (size_t i = 0; i < out.indices.size(); i++)
+                out.indices[i] = (unsigned int)i;
+        }
+        out.indices.resize(out.indices.size() / 3 * 3);
+
+        if (!hasNormals && wantNormals)
+        {
+            generateNormals(out.vertices, out.indices);
+            if (hasTangents)
+                for (size_t i = 0; i < out.vertices.size(); i++)
+                    out.vertices[i].Bitangent = glm::cross(out.vertices[i].Normal, out.vertices[i].Tangent) *
+                                                (tangents.components == 4 ? tangents.get(i, 3) : 1.0f);
+        }
+        if (hasTexCoords && !hasTangents && wantTangents)
+            generateTangents(out.vertices, out.indices);
+
+        // textures, mapped the way Assimp reports them to Model: base colour as diffuse, the
+        // specular(-glossiness) extensions as specular
+        const JsonValue &material = doc.json["materials"][primitive["material"].asSize((size_t)-1)];
+        out.diffuseTexture = doc.textureUri(material["pbrMetallicRoughness"]["baseColorTexture"]);
+        const JsonValue &extensions = material["extensions"];
+        if (extensions["KHR_materials_pbrSpecularGlossiness"].type == JsonValue::OBJECT)
+        {
+            const JsonValue &specularGlossiness = extensions["KHR_materials_pbrSpecularGlossiness"];
+            if (out.diffuseTexture.empty())
+                out.diffuseTexture = doc.textureUri(specularGlossiness["diffuseTexture"]);
+            out.specularTexture = doc.textureUri(specularGlossiness["specularGlossinessTexture"]);
+        }
+        if (out.specularTexture.empty())
+            out.specularTexture = doc.textureUri(extensions["KHR_materials_specular"]["specularTexture"]);
+        if (out.specularTexture.empty())
+            out.specularTexture = doc.textureUri(extensions["KHR_materials_specular"]["specularColorTexture"]);
+        return true;
+    }
+
+    // visits a node and its children depth first, like Model::processNode does with Assimp's tree
+    inline bool loadNode(Document &doc, size_t node, int depth, std::vector<GltfPrimitive> &primitives)
+    {
+        const JsonValue &value = doc.json["nodes"][node];
+        if (value.type != JsonValue::OBJECT || depth > 256)
+            return doc.fail("bad node");
+        if (value.has("mesh"))
+        {
+            const JsonValue &mesh = doc.json["meshes"][value["mesh"].asSize((size_t)-1)];
+            if (mesh.type != JsonValue::OBJECT)
+                return doc.fail("bad mesh index");
+            const JsonValue &list = mesh["primitives"];
+            for (size_t i = 0; i < list.size(); i++)
+            {
+                primitives.push_back(GltfPrimitive());
+                primitives.back().name = mesh["name"].text;
+                if (!loadPrimitive(doc, list[i], primitives.back()))
+                    return false;
+            }
+        }
+        const JsonValue &children = value["children"];
+        for (size_t i = 0; i < children.size(); i++)
+            if (!loadNode(doc, children[i].asSize((size_t)-1), depth + 1, primitives))
+                return false;
+        return true;
+    }
+}
+
+inline bool IsGltfPath(const std::string &path)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string ext = path.substr(dot);
+    for (char &c : ext)
+        c = (char)tolower((unsigned char)c);
+    return ext == ".gltf";
+}
+
+// reads every primitive of the default scene of a .gltf. returns false (with the reason in
+// 'error') if the file uses something this loader doesn't handle. 'attributes' (VERTEX_ATTRIB_*)
+// selects what is read or generated; the other Vertex members stay zero.
+inline bool LoadGltf(const std::string &path, std::vector<GltfPrimitive> &primitives, std::string &error,
+                     unsigned int attributes = VERTEX_ATTRIBS_ALL)
+{
+    using namespace gltf_detail;
+    primitives.clear();
+    Document doc;
+    doc.attributes = attributes;
+
+    std::string text;
+    {
+        LoadTimer timer(path, LOAD_STAGE_FILE_READ);
+        AssetFile file(path);
+        if (!file.isOpen())
+        {
+            error = "can't open file";
+            return false;
+        }
+        text = file.text();
+        timer.AddBytes(text.size());
+    }
+    bool parsed;
+    {
+        LoadTimer timer(path, LOAD_STAGE_PARSE, text.size());
+        parsed = JsonParser(text.data(), text.size()).parse(doc.json);
+    }
+    if (!parsed || doc.json.type != JsonValue::OBJECT)
+    {
+        error = "invalid JSON";
+        return false;
+    }
+    if (doc.json["extensionsRequired"].size() > 0)
+    {
+        error = "requires extension " + doc.json["extensionsRequired"][(size_t)0].text;
+        return false;
+    }
+
+    std::string directory;
+    size_t slash = path.find_last_of("/\\");
+    if (slash != std::string::npos)
+        directory = path.substr(0, slash + 1);
+    const JsonValue &buffers = doc.json["buffers"];
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        const std::string &uri = buffers[i]["uri"].text;
+        std::unique_ptr<AssetFile> file(new AssetFile());
+        if (uri.empty() || uri.compare(0, 5, "data:") == 0 || !file->open(directory + Document::decodeUri(uri)) ||
+            file->size() < buffers[i]["byteLength"].asSize())
+        {
+            error = "buffer " + std::to_string(i) + " is embedded or missing";
+            return false;
+        }
+        doc.buffers.push_back(std::move(file));
+    }
+
+    // the default scene's root nodes; without scenes every node nobody lists as a child
+    std::vector<size_t> roots;
+    const JsonValue &scene = doc.json["scenes"][(size_t)doc.json["scene"].asInt(0)];
+    if (scene.type == JsonValue::OBJECT)
+    {
+        for (size_t i = 0; i < scene["nodes"].size(); i++)
+            roots.push_back(scene["nodes"][i].asSize((size_t)-1));
+    }
+    else
+    {
+        const JsonValue &nodes = doc.json["nodes"];
+        std::vector<bool> isChild(nodes.size(), false);
+        for (size_t i = 0; i < nodes.size(); i++)
+            for (size_t c = 0; c < nodes[i]["children"].size(); c++)
+            {
+                size_t child = nodes[i]["children"][c].asSize((size_t)-1);
+                if (child < isChild.size())
+                    isChild[child] = true;
+            }
+        for (size_t i = 0; i < nodes.size(); i++)
+            if (!isChild[i])
+                roots.push_back(i);
+    }
+    // the vertex data is read from the mapped buffers here, so their file reads are part of the conversion
+    LoadTimer timer(path, LOAD_STAGE_VERTEX_CONVERSION, 0, 0);
+    for (size_t i = 0; i < roots.size(); i++)
+    {
+        if (!loadNode(doc, roots[i], 0, primitives))
+        {
+            error = doc.error;
+            primitives.clear();
+            return false;
+        }
+    }
+    size_t vertexCount = 0;
+    for (size_t i = 0; i < primitives.size(); i++)
+    {
+        vertexCount += primitives[i].vertices.size();
+        timer.AddBytes(primitives[i].vertices.size() * sizeof(Vertex) + primitives[i].indices.size() * sizeof(unsigned int));
+    }
+    timer.SetCount(vertexCount);
+    return true;
+}
+#endif
@@ -0,0 +1,89 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// first of the four locations (one per column) the per-instance model matrix takes in an
+// instanced vertex shader: layout (location = 7) in mat4 aInstanceModel;
+// 5 and 6 are left to the bone attributes of the animated models.
+const unsigned int INSTANCE_MATRIX_ATTRIB = 7;
+
+// Model matrices of the copies of a model drawn with one instanced call per mesh. The matrices go
+// into a vertex buffer read with a divisor of 1; Attach() points the bound VAO's instance
+// attributes at it and Detach() turns them off again, so the shared arena VAOs stay as the
+// non-instanced draws expect them. A CPU copy is kept for level of detail and sorting.
+// The buffer is deleted by clear(), not by the destructor: call it on the GL thread before the
+// context goes away.
+class InstanceBuffer
+{
+public:
+    InstanceBuffer() {}
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+    // replaces the instances. static sets call it once; sets that move every frame call it every
+    // frame (the buffer only grows, so the storage is reused).
+    void Upload(const std::vector<glm::mat4> &instanceMatrices)
+    {
+        matrices = instanceMatrices;
+        if(!buffer)
+            glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        size_t bytes = matrices.size() * sizeof(glm::mat4);
+        if(bytes > capacity)
+        {
+            capacity = bytes;
+            glBufferData(GL_ARRAY_BUFFER, capacity, matrices.empty() ? NULL : &matrices[0], GL_DYNAMIC_DRAW);
+        }
+        else if(bytes > 0)
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, &matrices[0]);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    unsigned int Count() const { return (unsigned int)matrices.size(); }
+    const std::vector<glm::mat4> &Matrices() const { return matrices; }
+
+    // sets up the instance matrix attributes on the bound VAO
+    void Attach() const
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for(unsigned int column = 0; column < 4; column++)
+        {
+            unsigned int location = INSTANCE_MATRIX_ATTRIB + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // turns the instance attributes of the bound VAO off again
+    static void Detach()
+    {
+        for(unsigned int column = 0; column < 4; column++)
+        {
+            glVertexAttribDivisor(INSTANCE_MATRIX_ATTRIB + column, 0);
+            glDisableVertexAttribArray(INSTANCE_MATRIX_ATTRIB + column);
+        }
+    }
+
+    void clear()
+    {
+        if(buffer)
+            glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        capacity = 0;
+        matrices.clear();
+    }
+
+private:
+    unsigned int buffer = 0;
+    size_t capacity = 0;
+    std::vector<glm::mat4> matrices;
+};
+#endif
@@ -0,0 +1,181 @@
+#ifndef LIGHT_BUFFER_H
+#define LIGHT_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+// uniform buffer binding points of the light blocks; any shader that declares them shares the data
+const unsigned int POINT_LIGHT_BLOCK_BINDING = 0;
+const unsigned int SPOT_LIGHT_BLOCK_BINDING = 1;
+const unsigned int MAX_POINT_LIGHTS = 32;   // MAX_LAMPS in the shaders
+
+// std140 mirrors of the GLSL blocks. a float after a vec3 fills its fourth component, so the
+// shader structs declare the fields in this order:
+//
+//     struct PointLight { vec3 position; float constant; vec3 ambient; float linear;
+//                         vec3 diffuse; float quadratic; vec3 specular; };
+//     layout(std140) uniform PointLightBlock { PointLight pointLights[MAX_LAMPS]; int numPointLights; };
+//
+//     struct SpotLight { vec3 position; float cutOff; vec3 direction; float outerCutOff;
+//                        vec3 ambient; float constant; vec3 diffuse; float linear;
+//                        vec3 specular; float quadratic; };
+//     layout(std140) uniform SpotLightBlock { SpotLight spotLight; };
+struct PointLightStd140 {
+    glm::vec3 position = glm::vec3(0.0f);   float constant = 1.0f;
+    glm::vec3 ambient = glm::vec3(0.0f);    float linear = 0.0f;
+    glm::vec3 diffuse = glm::vec3(0.0f);    float quadratic = 0.0f;
+    glm::vec3 specular = glm::vec3(0.0f);   float padding = 0.0f;
+};
+static_assert(sizeof(PointLightStd140) == 64, "PointLightStd140 must match the std140 layout");
+
+struct SpotLightStd140 {
+    glm::vec3 position = glm::vec3(0.0f);   float cutOff = 1.0f;
+    glm::vec3 direction = glm::vec3(0.0f);  float outerCutOff = 1.0f;
+    glm::vec3 ambient = glm::vec3(0.0f);    float constant = 1.0f;
+    glm::vec3 diffuse = glm::vec3(0.0f);    float linear = 0.0f;
+    glm::vec3 specular = glm::vec3(0.0f);   float quadratic = 0.0f;
+};
+static_assert(sizeof(SpotLightStd140) == 80, "SpotLightStd140 must match the std140 layout");
+
+// The scene's lights in two uniform buffers: the point lights (static lamps, uploaded when they
+// change, usually once) and the spot light (the flashlight, small and updated every frame).
+// Setters only write the CPU copy and mark what changed; Upload() sends the changed part.
+// Created on first Upload(); clear() deletes the buffers on the GL thread before the context goes away.
+class LightBuffer
+{
+public:
+    static LightBuffer &Instance()
+    {
+        static LightBuffer lights;
+        return lights;
+    }
+
+    LightBuffer(const LightBuffer &) = delete;
+    LightBuffer &operator=(const LightBuffer &) = delete;
+
+    // points the light blocks 'shader' declares at the shared binding points. once per shader.
+    static void Attach(Shader &shader)
+    {
+        shader.BindUniformBlock("PointLightBlock", POINT_LIGHT_BLOCK_BINDING);
+        shader.BindUniformBlock("SpotLightBlock", SPOT_LIGHT_BLOCK_BINDING);
+    }
+
+    void SetPointLight(unsigned int index, const PointLightStd140 &light)
+    {
+        if(index >= MAX_POINT_LIGHTS || memcmp(&points.lights[index], &light, sizeof(light)) == 0)
+            return;
+        points.lights[index] = light;
+        firstDirty = std::min(firstDirty, index);
+        lastDirty = std::max(lastDirty, index + 1);
+    }
+
+    void SetPointLightCount(unsigned int count)
+    {
+        count = std::min(count, MAX_POINT_LIGHTS);
+        if((unsigned int)points.count == count)
+            return;
+        points.count = (int)count;
+        countDirty = true;
+    }
+
+    void SetSpotLight(const SpotLightStd140 &light)
+    {
+        if(memcmp(&spot, &light, sizeof(light)) == 0)
+            return;
+        spot = light;
+        spotDirty = true;
+    }
+
+    unsigned int PointLightCount() const { return (unsigned int)points.count; }
+
+    // sends whatever changed since the last call; nothing when the lights are unchanged
+    void Upload()
+    {
+        if(!pointBuffer)
+            create();
+        if(firstDirty < lastDirty || countDirty)
+        {
+            glBindBuffer(GL_UNIFORM_BUFFER, pointBuffer);
+            if(firstDirty < lastDirty)
+            {
+                size_t bytes = (lastDirty - firstDirty) * sizeof(PointLightStd140);
+                glBufferSubData(GL_UNIFORM_BUFFER, firstDirty * sizeof(PointLightStd140), bytes, &points.lights[firstDirty]);
+                uploadedBytes += bytes;
+            }
+            if(countDirty)
+            {
+                glBufferSubData(GL_UNIFORM_BUFFER, offsetof(PointLightBlock, count), sizeof(int), &points.count);
+                uploadedBytes += sizeof(int);
+            }
+            firstDirty = MAX_POINT_LIGHTS;
+            lastDirty = 0;
+            countDirty = false;
+        }
+        if(spotDirty)
+        {
+            glBindBuffer(GL_UNIFORM_BUFFER, spotBuffer);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(spot), &spot);
+            uploadedBytes += sizeof(spot);
+            spotDirty = false;
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // bytes sent by Upload() so far
+    size_t UploadedBytes() const { return uploadedBytes; }
+
+    void clear()
+    {
+        if(pointBuffer)
+            glDeleteBuffers(1, &pointBuffer);
+        if(spotBuffer)
+            glDeleteBuffers(1, &spotBuffer);
+        pointBuffer = spotBuffer = 0;
+    }
+
+private:
+    struct PointLightBlock {
+        PointLightStd140 lights[MAX_POINT_LIGHTS];
+        int count = 0;
+        int padding[3] = { 0, 0, 0 };
+    };
+
+    PointLightBlock points;
+    SpotLightStd140 spot;
+    unsigned int pointBuffer = 0;
+    unsigned int spotBuffer = 0;
+    unsigned int firstDirty = MAX_POINT_LIGHTS;   // dirty point lights are [firstDirty, lastDirty)
+    unsigned int lastDirty = 0;
+    bool countDirty = false;
+    bool spotDirty = false;
+    size_t uploadedBytes = 0;
+
+    LightBuffer() {}
+
+    // both buffers get their whole block right away, so a buffer is never read uninitialized
+    void create()
+    {
+        glGenBuffers(1, &pointBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, pointBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(points), &points, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, POINT_LIGHT_BLOCK_BINDING, pointBuffer);
+
+        glGenBuffers(1, &spotBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, spotBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(spot), &spot, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, SPOT_LIGHT_BLOCK_BINDING, spotBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        uploadedBytes += sizeof(points) + sizeof(spot);
+        firstDirty = MAX_POINT_LIGHTS;
+        lastDirty = 0;
+        countDirty = spotDirty = false;
+    }
+};
+#endif
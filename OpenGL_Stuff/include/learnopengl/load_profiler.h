@@ -0,0 +1,292 @@
+#ifndef LOAD_PROFILER_H
+#define LOAD_PROFILER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <learnopengl/allocation_counter.h>
+
+// steps of the asset load path the LoadProfiler tells apart
+enum LoadStage {
+    LOAD_STAGE_FILE_READ,           // shader sources, mesh caches, glTF files, cached DDS textures
+    LOAD_STAGE_PARSE,               // Assimp ReadFile, or the glTF JSON for the direct loader
+    LOAD_STAGE_VERTEX_CONVERSION,   // importer data to Vertex/index arrays
+    LOAD_STAGE_MESH_PROCESSING,     // vertex cache optimization and LOD generation
+    LOAD_STAGE_BONE_EXTRACTION,     // bone weights of skinned meshes (model1.h)
+    LOAD_STAGE_IMAGE_DECODE,        // stb_image
+    LOAD_STAGE_TEXTURE_COMPRESSION, // BC encoding and the CPU mip chain of texture_compress.h
+    LOAD_STAGE_GL_UPLOAD,           // buffer and texture uploads
+    LOAD_STAGE_MIP_GENERATION,      // glGenerateMipmap
+    LOAD_STAGE_SHADER_COMPILE,      // compile and link
+    LOAD_STAGE_COUNT
+};
+
+inline const char *LoadStageName(LoadStage stage)
+{
+    static const char *names[LOAD_STAGE_COUNT] = {
+        "file read", "parse", "vertex conversion", "mesh processing", "bone extraction",
+        "image decode", "texture compression", "GL upload", "mip generation", "shader compile"
+    };
+    return names[stage];
+}
+
+// the same names as JSON keys
+inline const char *LoadStageKey(LoadStage stage)
+{
+    static const char *keys[LOAD_STAGE_COUNT] = {
+        "file_read", "parse", "vertex_conversion", "mesh_processing", "bone_extraction",
+        "image_decode", "texture_compression", "gl_upload", "mip_generation", "shader_compile"
+    };
+    return keys[stage];
+}
+
+struct LoadStageStats {
+    double   seconds = 0.0;
+    uint64_t bytes = 0;
+    uint64_t count = 0;
+
+    void add(const LoadStageStats &other)
+    {
+        seconds += other.seconds;
+        bytes += other.bytes;
+        count += other.count;
+    }
+};
+
+// Collects how long each stage of loading takes, per asset (a model, texture or shader path), with
+// the bytes and items it handled. Records come from the loader thread and the decode pool as well
+// as the GL thread, so stage times are summed over threads and can add up to more than the wall
+// time of the load. GL stages measure the driver calls, not the GPU work they queue.
+// The report is meant to be compared between builds: PrintReport() for the console, WriteJson()
+// for tools. It also counts the heap allocations made since Begin(), on every thread, when the
+// program compiles the allocation counter in (allocation_counter.h).
+class LoadProfiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct AssetStats {
+        std::string name;
+        LoadStageStats stages[LOAD_STAGE_COUNT];
+
+        double seconds() const
+        {
+            double total = 0.0;
+            for (int i = 0; i < LOAD_STAGE_COUNT; i++)
+                total += stages[i].seconds;
+            return total;
+        }
+    };
+
+    static LoadProfiler &Instance()
+    {
+        static LoadProfiler profiler;
+        return profiler;
+    }
+
+    // forgets what was recorded and restarts the wall clock of the report
+    void Begin()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        assets.clear();
+        start = Clock::now();
+        startAllocations = CurrentAllocations();
+    }
+
+    void Record(const std::string &asset, LoadStage stage, double seconds, uint64_t bytes, uint64_t count = 1)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        AssetStats &stats = assets[asset];
+        stats.stages[stage].seconds += seconds;
+        stats.stages[stage].bytes += bytes;
+        stats.stages[stage].count += count;
+    }
+
+    static double SecondsSince(Clock::time_point from)
+    {
+        return std::chrono::duration<double>(Clock::now() - from).count();
+    }
+
+    // seconds since Begin()
+    double WallSeconds() const
+    {
+        return SecondsSince(start);
+    }
+
+    // heap allocations since Begin(), zero if the counter isn't compiled in
+    AllocationSnapshot Allocations() const
+    {
+        return AllocationsSince(startAllocations);
+    }
+
+    // every asset with its stages, slowest first
+    std::vector<AssetStats> Assets() const
+    {
+        std::vector<AssetStats> result;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (std::map<std::string, AssetStats>::const_iterator it = assets.begin(); it != assets.end(); ++it)
+            {
+                result.push_back(it->second);
+                result.back().name = it->first;
+            }
+        }
+        std::stable_sort(result.begin(), result.end(), [](const AssetStats &a, const AssetStats &b) { return a.seconds() > b.seconds(); });
+        return result;
+    }
+
+    // the stages summed over every asset
+    AssetStats Totals() const
+    {
+        std::vector<AssetStats> all = Assets();
+        AssetStats totals;
+        totals.name = "total";
+        for (size_t i = 0; i < all.size(); i++)
+            for (int s = 0; s < LOAD_STAGE_COUNT; s++)
+                totals.stages[s].add(all[i].stages[s]);
+        return totals;
+    }
+
+    void PrintReport(std::ostream &out) const
+    {
+        std::vector<AssetStats> all = Assets();
+        AssetStats totals = Totals();
+        out << "LOAD_PROFILE:: " << all.size() << " assets in " << std::fixed << std::setprecision(1)
+            << WallSeconds() * 1000.0 << " ms wall, " << totals.seconds() * 1000.0 << " ms summed over threads" << std::endl;
+        AllocationSnapshot allocations = Allocations();
+        if (allocations.count > 0)
+            out << "  " << allocations.count << " heap allocations, " << allocations.bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+        for (int s = 0; s < LOAD_STAGE_COUNT; s++)
+        {
+            const LoadStageStats &stage = totals.stages[s];
+            if (stage.count == 0)
+                continue;
+            out << "  " << std::left << std::setw(20) << LoadStageName((LoadStage)s) << std::right
+                << std::setw(9) << stage.seconds * 1000.0 << " ms" << std::setw(9) << stage.bytes / (1024.0 * 1024.0) << " MB"
+                << std::setw(7) << stage.count << std::endl;
+        }
+        for (size_t i = 0; i < all.size(); i++)
+        {
+            out << "  " << all[i].name << ": " << all[i].seconds() * 1000.0 << " ms (";
+            bool first = true;
+            for (int s = 0; s < LOAD_STAGE_COUNT; s++)
+            {
+                if (all[i].stages[s].count == 0)
+                    continue;
+                out << (first ? "" : ", ") << LoadStageName((LoadStage)s) << " " << all[i].stages[s].seconds * 1000.0;
+                first = false;
+            }
+            out << ")" << std::endl;
+        }
+        out.unsetf(std::ios::fixed);
+        out << std::setprecision(6);
+    }
+
+    // { "wall_ms": .., "allocations": { "count": .., "bytes": .. }, "totals": { stage: {ms, bytes, count} }, "assets": [ { "name": .., "ms": .., "stages": {..} } ] }
+    void WriteJson(std::ostream &out) const
+    {
+        std::vector<AssetStats> all = Assets();
+        out << std::fixed << std::setprecision(3);
+        AllocationSnapshot allocations = Allocations();
+        out << "{\n  \"wall_ms\": " << WallSeconds() * 1000.0;
+        if (allocations.count > 0)
+            out << ",\n  \"allocations\": { \"count\": " << allocations.count << ", \"bytes\": " << allocations.bytes << " }";
+        out << ",\n  \"totals\": ";
+        writeStages(out, Totals());
+        out << ",\n  \"assets\": [";
+        for (size_t i = 0; i < all.size(); i++)
+        {
+            out << (i ? "," : "") << "\n    { \"name\": \"" << escape(all[i].name) << "\", \"ms\": " << all[i].seconds() * 1000.0 << ", \"stages\": ";
+            writeStages(out, all[i]);
+            out << " }";
+        }
+        out << "\n  ]\n}\n";
+        out.unsetf(std::ios::fixed);
+        out << std::setprecision(6);
+    }
+
+    bool WriteJsonFile(const std::string &path) const
+    {
+        std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+        WriteJson(file);
+        return (bool)file;
+    }
+
+private:
+    mutable std::mutex mutex;
+    std::map<std::string, AssetStats> assets;
+    Clock::time_point start = Clock::now();
+    AllocationSnapshot startAllocations;
+
+    LoadProfiler() {}
+
+    static void writeStages(std::ostream &out, const AssetStats &stats)
+    {
+        out << "{";
+        bool first = true;
+        for (int s = 0; s < LOAD_STAGE_COUNT; s++)
+        {
+            const LoadStageStats &stage = stats.stages[s];
+            if (stage.count == 0)
+                continue;
+            out << (first ? " " : ", ") << "\"" << LoadStageKey((LoadStage)s) << "\": { \"ms\": " << stage.seconds * 1000.0
+                << ", \"bytes\": " << stage.bytes << ", \"count\": " << stage.count << " }";
+            first = false;
+        }
+        out << " }";
+    }
+
+    static std::string escape(const std::string &text)
+    {
+        std::string result;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            char c = text[i];
+            if (c == '"' || c == '\\')
+                result += '\\';
+            if ((unsigned char)c >= 0x20)
+                result += c;
+        }
+        return result;
+    }
+};
+
+// times its scope and records it under 'asset' and 'stage' when it ends. the bytes and count can
+// be filled in while the work runs.
+class LoadTimer
+{
+public:
+    LoadTimer(const std::string &asset, LoadStage stage, uint64_t bytes = 0, uint64_t count = 1)
+        : asset(asset), stage(stage), bytes(bytes), count(count), start(LoadProfiler::Clock::now())
+    {
+    }
+
+    ~LoadTimer()
+    {
+        LoadProfiler::Instance().Record(asset, stage, LoadProfiler::SecondsSince(start), bytes, count);
+    }
+
+    LoadTimer(const LoadTimer &) = delete;
+    LoadTimer &operator=(const LoadTimer &) = delete;
+
+    void AddBytes(uint64_t amount) { bytes += amount; }
+    void SetCount(uint64_t value) { count = value; }
+
+private:
+    std::string asset;
+    LoadStage stage;
+    uint64_t bytes;
+    uint64_t count;
+    LoadProfiler::Clock::time_point start;
+};
+#endif
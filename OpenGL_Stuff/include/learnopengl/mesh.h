@@ -5,9 +5,16 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/texture_array.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 using namespace std;
@@ -25,10 +32,179 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// vertex attributes by shader location, bit n for location n, the way Shader::ActiveAttributeMask()
+// reports them. a Model loaded for a mask only imports and uploads those attributes.
+const unsigned int VERTEX_ATTRIB_POSITION  = 1 << 0;
+const unsigned int VERTEX_ATTRIB_NORMAL    = 1 << 1;
+const unsigned int VERTEX_ATTRIB_TEXCOORDS = 1 << 2;
+const unsigned int VERTEX_ATTRIB_TANGENT   = 1 << 3;
+const unsigned int VERTEX_ATTRIB_BITANGENT = 1 << 4;
+const unsigned int VERTEX_ATTRIBS_ALL = VERTEX_ATTRIB_POSITION | VERTEX_ATTRIB_NORMAL | VERTEX_ATTRIB_TEXCOORDS |
+                                        VERTEX_ATTRIB_TANGENT | VERTEX_ATTRIB_BITANGENT;
+const unsigned int VERTEX_ATTRIBS_TANGENT_FRAME = VERTEX_ATTRIB_TANGENT | VERTEX_ATTRIB_BITANGENT;
+
+// vertex attribute layout of Vertex, set up once per arena page
+inline void SetupVertexAttributes()
+{
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    // vertex tangent
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+    // vertex bitangent
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+}
+
+// Vertex without the tangent frame (32 bytes), for meshes whose shader doesn't read locations 3 and 4
+struct BasicVertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+};
+
+inline void SetupBasicVertexAttributes()
+{
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(BasicVertex), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(BasicVertex), (void*)offsetof(BasicVertex, Normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(BasicVertex), (void*)offsetof(BasicVertex, TexCoords));
+}
+
+// compact layout for static meshes: 20 bytes instead of the 56 of Vertex.
+// the position is quantized to 16 bits against the mesh bounds (shaders rebuild it with
+// positionScale/positionOffset), normal and tangent are 10:10:10:2 snorm with the bitangent
+// handedness in the tangent's w, and the uvs are half floats.
+struct PackedVertex {
+    uint16_t Position[4];  // xyz, w unused (keeps the next attribute 4-byte aligned)
+    uint32_t Normal;
+    uint16_t TexCoords[2];
+    uint32_t Tangent;
+};
+
+inline void SetupPackedVertexAttributes()
+{
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Tangent));
+}
+
+// PackedVertex without the tangent (16 bytes)
+struct PackedBasicVertex {
+    uint16_t Position[4];
+    uint32_t Normal;
+    uint16_t TexCoords[2];
+};
+
+inline void SetupPackedBasicVertexAttributes()
+{
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedBasicVertex), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedBasicVertex), (void*)offsetof(PackedBasicVertex, Normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedBasicVertex), (void*)offsetof(PackedBasicVertex, TexCoords));
+}
+
+// the shared vertex/index buffers every Mesh sub-allocates from
+inline GeometryPool &MeshGeometry()
+{
+    static GeometryPool pool(sizeof(Vertex), SetupVertexAttributes);
+    return pool;
+}
+
+// packed meshes, split by index size: 16-bit indices whenever the vertex count allows
+inline GeometryPool &PackedGeometry16()
+{
+    static GeometryPool pool(sizeof(PackedVertex), SetupPackedVertexAttributes, GL_UNSIGNED_SHORT);
+    return pool;
+}
+
+inline GeometryPool &PackedGeometry32()
+{
+    static GeometryPool pool(sizeof(PackedVertex), SetupPackedVertexAttributes, GL_UNSIGNED_INT);
+    return pool;
+}
+
+// the same pools for meshes uploaded without the tangent frame
+inline GeometryPool &BasicMeshGeometry()
+{
+    static GeometryPool pool(sizeof(BasicVertex), SetupBasicVertexAttributes);
+    return pool;
+}
+
+inline GeometryPool &PackedBasicGeometry16()
+{
+    static GeometryPool pool(sizeof(PackedBasicVertex), SetupPackedBasicVertexAttributes, GL_UNSIGNED_SHORT);
+    return pool;
+}
+
+inline GeometryPool &PackedBasicGeometry32()
+{
+    static GeometryPool pool(sizeof(PackedBasicVertex), SetupPackedBasicVertexAttributes, GL_UNSIGNED_INT);
+    return pool;
+}
+
+// deletes the GL objects of every geometry pool. call before destroying the context.
+inline void ClearMeshGeometry()
+{
+    MeshGeometry().clear();
+    PackedGeometry16().clear();
+    PackedGeometry32().clear();
+    BasicMeshGeometry().clear();
+    PackedBasicGeometry16().clear();
+    PackedBasicGeometry32().clear();
+}
+
+// levels of detail a Mesh can carry, the full mesh included
+const int MESH_MAX_LODS = 4;
+
+// a coarser version of a mesh. it indexes the same vertices as the full mesh.
+struct MeshLod {
+    vector<unsigned int> indices;
+};
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
+    TextureArrayLayer arrayLayer;   // set when the texture was packed into a TextureArraySet
+};
+
+// texture units bound so far by one Model::Draw, so consecutive meshes that use the same
+// texture (or texture array) don't bind it again
+struct TextureBindings {
+    unsigned int bound[16] = { 0 };
+    size_t binds = 0;     // glBindTexture calls made
+    size_t skipped = 0;   // and avoided
+
+    void Bind(unsigned int unit, GLenum target, unsigned int texture)
+    {
+        if(unit < 16 && bound[unit] == texture)
+        {
+            skipped++;
+            return;
+        }
+        if(unit < 16)
+            bound[unit] = texture;
+        binds++;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+    }
 };
 
 class Mesh {
@@ -37,98 +213,319 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
+    vector<MeshLod>      lods;      // levels 1.. (level 0 is 'indices'); uploaded after it in the same range
+    GeometryAllocation   geometry;  // where the mesh lives in its geometry pool
+    // upload with the PackedVertex layout. set before Upload(); the shader must handle quantizedPositions.
+    bool packed = false;
+    // VERTEX_ATTRIB_* the shader reads. set before Upload(); without the tangent frame the mesh
+    // goes to the BasicVertex / PackedBasicVertex pools.
+    unsigned int attributes = VERTEX_ATTRIBS_ALL;
+    // object space bounds of the vertices, computed at import: the box and a sphere around its
+    // centre that holds every vertex (tighter than the box's half diagonal)
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCentre = glm::vec3(0.0f);
+    float     boundsRadius = 0.0f;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor. with 'upload' false the GL objects are created later by Upload(), which lets
+    // meshes be built on a loader thread that has no GL context.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool upload = true)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        computeBounds();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if(upload)
+            setupMesh();
+    }
+
+    // creates the GL buffers of a mesh constructed without upload. must run on the GL thread.
+    void Upload()
+    {
+        if(!uploaded)
+            setupMesh();
+    }
+
+    bool IsUploaded() const { return uploaded; }
+
+    // returns the mesh's range to the arena. meshes are copied around freely, so this is explicit:
+    // the owner (Model) calls it once, on the GL thread.
+    void Release()
+    {
+        if(pool)
+            pool->Release(geometry);
+        pool = nullptr;
+        uploaded = false;
+    }
+
+    // bytes sent to the GPU by Upload()
+    size_t UploadSize() const
+    {
+        if(!packed)
+            return vertices.size() * vertexStride() + TotalIndexCount() * sizeof(unsigned int);
+        return vertices.size() * vertexStride() + TotalIndexCount() * (useShortIndices() ? sizeof(uint16_t) : sizeof(uint32_t));
+    }
+
+    unsigned int LodCount() const { return 1 + (unsigned int)lods.size(); }
+
+    // indices of every level together
+    size_t TotalIndexCount() const
+    {
+        size_t count = indices.size();
+        for(unsigned int i = 0; i < lods.size(); i++)
+            count += lods[i].indices.size();
+        return count;
     }
 
     // render the mesh
     void Draw(Shader &shader) 
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-             else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-        
+        if(!uploaded)
+            return;
+
+        BindTextures(shader);
+        BindQuantization(shader);
+
         // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(VertexArray());
+        DrawElements();
         glBindVertexArray(0);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // VAO of the arena page holding this mesh; shared with every mesh of the same page
+    unsigned int VertexArray() const { return pool->VertexArray(geometry.page); }
+
+    // issues the draw call only, for level 'lod' (clamped to the levels this mesh has).
+    // the VAO from VertexArray() must be bound.
+    void DrawElements(unsigned int lod = 0) const
+    {
+        unsigned int first, count;
+        lodRange(lod, first, count);
+        pool->DrawRange(geometry, first, count);
+    }
+
+    // draws level 'lod' once per instance in a single call. the VAO from VertexArray() must be
+    // bound with the instance matrices attached (InstanceBuffer::Attach).
+    void DrawElementsInstanced(unsigned int lod, unsigned int instances) const
+    {
+        unsigned int first, count;
+        lodRange(lod, first, count);
+        pool->DrawRangeInstanced(geometry, first, count, instances);
+    }
+
+    // tells the shader how to rebuild positions: quantized meshes scale their 0..1 positions
+    // by the bounds, full float meshes use them as they are
+    void BindQuantization(Shader &shader) const
+    {
+        const MeshUniforms &uniforms = shader.MeshBindings();
+        shader.set(uniforms.quantizedPositions, packed);
+        if(packed)
+        {
+            shader.set(uniforms.positionScale, quantizationScale());
+            shader.set(uniforms.positionOffset, boundsMin);
+        }
+    }
+
+    // binds the mesh's textures. a diffuse/specular texture packed in an array binds the array on its
+    // own unit and sets diffuseLayer/specularLayer instead (-1 when the plain sampler is used).
+    // 'bindings' (optional) skips binds that are already in place.
+    void BindTextures(Shader &shader, TextureBindings *bindings = nullptr)
+    {
+        TextureBindings local;
+        if(!bindings)
+            bindings = &local;
+        const MeshUniforms &uniforms = shader.MeshBindings();
+        int diffuseLayer = -1;
+        int specularLayer = -1;
+        // bind appropriate textures
+        unsigned int counts[MATERIAL_TEXTURE_KINDS] = { 0 };
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            // retrieve texture number (the N in diffuse_textureN); other types use their name as is
+            int kind = GetMaterialTextureKind(textures[i].type);
+            unsigned int number = kind >= 0 ? ++counts[kind] : 0;
+
+            const TextureArrayLayer &arrayLayer = textures[i].arrayLayer;
+            if(arrayLayer.valid() && number == 1 && kind == MATERIAL_DIFFUSE)
+            {
+                bindings->Bind(TEXTURE_ARRAY_UNIT_DIFFUSE, GL_TEXTURE_2D_ARRAY, arrayLayer.array);
+                diffuseLayer = arrayLayer.layer;
+                continue;
+            }
+            if(arrayLayer.valid() && number == 1 && kind == MATERIAL_SPECULAR)
+            {
+                bindings->Bind(TEXTURE_ARRAY_UNIT_SPECULAR, GL_TEXTURE_2D_ARRAY, arrayLayer.array);
+                specularLayer = arrayLayer.layer;
+                continue;
+            }
+
+            // now set the sampler to the correct texture unit (locations come from the shader's table)
+            shader.BindSampler(kind >= 0 ? shader.SamplerLocation(kind, number) : shader.Location(textures[i].type), i);
+            // and finally bind the texture
+            bindings->Bind(i, GL_TEXTURE_2D, textures[i].id);
+        }
+        shader.BindSampler(uniforms.diffuseArray.location, TEXTURE_ARRAY_UNIT_DIFFUSE);
+        shader.BindSampler(uniforms.specularArray.location, TEXTURE_ARRAY_UNIT_SPECULAR);
+        shader.set(uniforms.diffuseLayer, diffuseLayer);
+        shader.set(uniforms.specularLayer, specularLayer);
+    }
+
 private:
-    // render data 
-    unsigned int VBO, EBO;
+    bool uploaded = false;
+    GeometryPool *pool = nullptr;
+
+    // indices of level 'lod' (clamped to the levels this mesh has) within the mesh's range
+    void lodRange(unsigned int lod, unsigned int &first, unsigned int &count) const
+    {
+        if(lod >= LodCount())
+            lod = LodCount() - 1;
+        first = 0;
+        count = (unsigned int)indices.size();
+        for(unsigned int i = 0; i < lod; i++)
+        {
+            first += count;
+            count = (unsigned int)lods[i].indices.size();
+        }
+    }
+
+    bool useShortIndices() const { return vertices.size() <= 65536; }
+
+    bool hasTangentFrame() const { return (attributes & VERTEX_ATTRIBS_TANGENT_FRAME) != 0; }
+
+    // bytes per vertex of the layout Upload() uses
+    size_t vertexStride() const
+    {
+        if(packed)
+            return hasTangentFrame() ? sizeof(PackedVertex) : sizeof(PackedBasicVertex);
+        return hasTangentFrame() ? sizeof(Vertex) : sizeof(BasicVertex);
+    }
+
+    // size of the box the quantized positions span; flat axes get 1 so nothing divides by zero
+    glm::vec3 quantizationScale() const
+    {
+        glm::vec3 scale = boundsMax - boundsMin;
+        for(int axis = 0; axis < 3; axis++)
+            if(scale[axis] <= 0.0f)
+                scale[axis] = 1.0f;
+        return scale;
+    }
+
+    // box and bounding sphere of the vertices
+    void computeBounds()
+    {
+        if(vertices.empty())
+            return;
+        boundsMin = boundsMax = vertices[0].Position;
+        for(unsigned int i = 1; i < vertices.size(); i++)
+        {
+            boundsMin = glm::min(boundsMin, vertices[i].Position);
+            boundsMax = glm::max(boundsMax, vertices[i].Position);
+        }
+        boundsCentre = (boundsMin + boundsMax) * 0.5f;
+        float radiusSquared = 0.0f;
+        for(unsigned int i = 0; i < vertices.size(); i++)
+        {
+            glm::vec3 offset = vertices[i].Position - boundsCentre;
+            radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+        boundsRadius = std::sqrt(radiusSquared);
+    }
 
-    // initializes all the buffer objects/arrays
+    // copies the mesh into the geometry arena
     void setupMesh()
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
-        // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        // the levels of detail follow the full index list in the same allocation
+        vector<unsigned int> chainedIndices;
+        if(!lods.empty())
+        {
+            chainedIndices.reserve(TotalIndexCount());
+            chainedIndices.insert(chainedIndices.end(), indices.begin(), indices.end());
+            for(unsigned int i = 0; i < lods.size(); i++)
+                chainedIndices.insert(chainedIndices.end(), lods[i].indices.begin(), lods[i].indices.end());
+        }
+        const vector<unsigned int> &allIndices = lods.empty() ? indices : chainedIndices;
 
-        glBindVertexArray(0);
+        if(!packed && hasTangentFrame())
+        {
+            pool = &MeshGeometry();
+            geometry = pool->Allocate(vertices.empty() ? nullptr : &vertices[0], (unsigned int)vertices.size(),
+                                      allIndices.empty() ? nullptr : &allIndices[0], (unsigned int)allIndices.size());
+            uploaded = true;
+            return;
+        }
+        if(!packed)
+        {
+            vector<BasicVertex> basicVertices(vertices.size());
+            for(unsigned int i = 0; i < vertices.size(); i++)
+            {
+                basicVertices[i].Position = vertices[i].Position;
+                basicVertices[i].Normal = vertices[i].Normal;
+                basicVertices[i].TexCoords = vertices[i].TexCoords;
+            }
+            pool = &BasicMeshGeometry();
+            geometry = pool->Allocate(basicVertices.empty() ? nullptr : &basicVertices[0], (unsigned int)basicVertices.size(),
+                                      allIndices.empty() ? nullptr : &allIndices[0], (unsigned int)allIndices.size());
+            uploaded = true;
+            return;
+        }
+
+        vector<PackedVertex> packedVertices(vertices.size());
+        glm::vec3 scale = quantizationScale();
+        for(unsigned int i = 0; i < vertices.size(); i++)
+        {
+            const Vertex &vertex = vertices[i];
+            PackedVertex &out = packedVertices[i];
+            glm::vec3 position = (vertex.Position - boundsMin) / scale;
+            for(int axis = 0; axis < 3; axis++)
+                out.Position[axis] = glm::packUnorm1x16(position[axis]);
+            out.Position[3] = 0;
+            out.Normal = glm::packSnorm3x10_1x2(glm::vec4(safeNormalize(vertex.Normal), 0.0f));
+            out.TexCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+            out.TexCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+            // the bitangent is cross(normal, tangent) * w
+            out.Tangent = 0;
+            if(hasTangentFrame())
+            {
+                float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+                out.Tangent = glm::packSnorm3x10_1x2(glm::vec4(safeNormalize(vertex.Tangent), handedness));
+            }
+        }
+
+        // without the tangent frame only the PackedBasicVertex prefix of each vertex is uploaded
+        vector<PackedBasicVertex> basicVertices;
+        const void *vertexData = packedVertices.empty() ? nullptr : &packedVertices[0];
+        if(!hasTangentFrame())
+        {
+            basicVertices.resize(packedVertices.size());
+            for(unsigned int i = 0; i < packedVertices.size(); i++)
+                memcpy(&basicVertices[i], &packedVertices[i], sizeof(PackedBasicVertex));
+            vertexData = basicVertices.empty() ? nullptr : &basicVertices[0];
+        }
+
+        if(useShortIndices())
+        {
+            vector<uint16_t> shortIndices(allIndices.begin(), allIndices.end());
+            pool = hasTangentFrame() ? &PackedGeometry16() : &PackedBasicGeometry16();
+            geometry = pool->Allocate(vertexData, (unsigned int)packedVertices.size(),
+                                      shortIndices.empty() ? nullptr : &shortIndices[0], (unsigned int)shortIndices.size());
+        }
+        else
+        {
+            pool = hasTangentFrame() ? &PackedGeometry32() : &PackedBasicGeometry32();
+            geometry = pool->Allocate(vertexData, (unsigned int)packedVertices.size(),
+                                      allIndices.empty() ? nullptr : &allIndices[0], (unsigned int)allIndices.size());
+        }
+        uploaded = true;
+    }
+
+    static glm::vec3 safeNormalize(const glm::vec3 &v)
+    {
+        float length = glm::length(v);
+        return length > 0.0f ? v / length : glm::vec3(0.0f);
     }
 };
-#endif
\ No newline at end of file
+#endif
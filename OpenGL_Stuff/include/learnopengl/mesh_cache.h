@@ -0,0 +1,424 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/mapped_file.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+using namespace std;
+
+// On-disk cache of an imported model, stored next to the source asset as "<asset>.meshcache".
+// The file is a flat, 16-byte aligned image that is memory-mapped when loading:
+//
+//   MeshCacheHeader
+//   MeshCacheDependency[dependencyCount]   size + mtime of every source file the import read
+//   MeshCacheMeshRecord[meshCount]
+//   MeshCacheTextureRecord[textureCount]   material texture references, grouped per mesh
+//   MeshCacheBoneRecord[boneCount]
+//   Vertex[...]                            already converted vertices of all meshes, back to back
+//   unsigned int[...]                      indices of all meshes, back to back (each mesh's LOD levels follow its own indices)
+//   char[...]                              string table (texture types/paths, bone names)
+//
+// Any change to the layout of Vertex or to the records below must bump MESH_CACHE_VERSION.
+const uint32_t MESH_CACHE_MAGIC = 0x48434D4C; // "LMCH"
+const uint32_t MESH_CACHE_VERSION = 4;
+
+// processing applied to the meshes after the import, on top of the Assimp flags. a cache is only
+// reused by a load that asks for the same processing.
+const uint32_t MESH_PROCESS_OPTIMIZED = 1 << 0;   // welded and reordered by OptimizeMesh()
+const uint32_t MESH_PROCESS_LODS = 1 << 1;        // LOD chain built by GenerateMeshLods()
+const uint32_t MESH_PROCESS_DIRECT_GLTF = 1 << 2; // the meshes of a .gltf came from gltf_loader.h, not the Assimp fallback
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexStride;
+    uint32_t importFlags;
+    uint32_t processFlags;
+    uint32_t reserved;
+    uint32_t dependencyCount;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t boneCount;
+    uint64_t dependencyOffset;
+    uint64_t meshOffset;
+    uint64_t textureOffset;
+    uint64_t boneOffset;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t stringOffset;
+    uint64_t fileSize;
+};
+
+struct MeshCacheDependency {
+    uint64_t size;
+    int64_t  mtime;
+};
+
+struct MeshCacheMeshRecord {
+    uint64_t firstVertex;
+    uint64_t firstIndex;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    uint32_t lodCount;                              // levels besides the full mesh
+    uint32_t lodIndexCount[MESH_MAX_LODS - 1];
+};
+
+// indices of a mesh record, LOD levels included
+inline uint64_t MeshCacheIndexCount(const MeshCacheMeshRecord &record)
+{
+    uint64_t count = record.indexCount;
+    for (uint32_t i = 0; i < record.lodCount && i < MESH_MAX_LODS - 1; i++)
+        count += record.lodIndexCount[i];
+    return count;
+}
+
+struct MeshCacheTextureRecord {
+    uint32_t typeOffset;
+    uint32_t typeLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+struct MeshCacheBoneRecord {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    int32_t  id;
+    uint32_t padding;
+    float    offset[16];
+};
+
+// a bone as stored in the cache. skinned models (model1.h) keep these in their BoneInfo map.
+struct MeshCacheBone {
+    string    name;
+    int       id;
+    glm::mat4 offset;
+};
+
+class MeshCache
+{
+public:
+    // path of the cache file that belongs to a source asset
+    static string CachePath(const string &sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    // every file the importer reads for 'sourcePath': the asset itself plus the companion
+    // files Assimp pulls in (.bin buffers of a .gltf, .mtl library of an .obj). they are stamped
+    // from the mounted asset pack when it has them.
+    static vector<string> Dependencies(const string &sourcePath)
+    {
+        vector<string> files;
+        files.push_back(sourcePath);
+
+        size_t dot = sourcePath.find_last_of('.');
+        if (dot == string::npos)
+            return files;
+        string stem = sourcePath.substr(0, dot);
+        string ext = sourcePath.substr(dot);
+        for (char &c : ext)
+            c = (char)tolower((unsigned char)c);
+
+        string companion;
+        if (ext == ".gltf")
+            companion = stem + ".bin";
+        else if (ext == ".obj")
+            companion = stem + ".mtl";
+
+        FileStamp stamp;
+        if (!companion.empty() && GetAssetStamp(companion, stamp))
+            files.push_back(companion);
+        return files;
+    }
+
+    // maps the cache of 'sourcePath' and checks it against the current source files.
+    // returns false (and keeps nothing mapped) if the cache is missing, stale or was written by another version.
+    // 'optionalProcessFlags' are the bits that only record how the meshes were imported: the cache may
+    // have them or not.
+    bool open(const string &sourcePath, uint32_t importFlags, uint32_t processFlags, uint32_t optionalProcessFlags = 0)
+    {
+        close();
+        vector<FileStamp> stamps;
+        if (!currentStamps(sourcePath, stamps))
+            return false;
+        if (!file.open(CachePath(sourcePath)))
+            return false;
+
+        if (file.size() < sizeof(MeshCacheHeader))
+            return fail();
+        header = (const MeshCacheHeader *)file.data();
+        if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION ||
+            header->vertexStride != sizeof(Vertex) || header->importFlags != importFlags ||
+            (header->processFlags & ~optionalProcessFlags) != (processFlags & ~optionalProcessFlags) ||
+            header->fileSize != file.size())
+            return fail();
+
+        // every section has to lie inside the file
+        if (!inside(header->dependencyOffset, (uint64_t)header->dependencyCount * sizeof(MeshCacheDependency)) ||
+            !inside(header->meshOffset, (uint64_t)header->meshCount * sizeof(MeshCacheMeshRecord)) ||
+            !inside(header->textureOffset, (uint64_t)header->textureCount * sizeof(MeshCacheTextureRecord)) ||
+            !inside(header->boneOffset, (uint64_t)header->boneCount * sizeof(MeshCacheBoneRecord)) ||
+            header->vertexOffset > header->indexOffset || header->indexOffset > header->stringOffset ||
+            header->stringOffset > header->fileSize)
+            return fail();
+
+        // the cache is only valid for the exact source files it was built from
+        if (header->dependencyCount != stamps.size())
+            return fail();
+        const MeshCacheDependency *deps = (const MeshCacheDependency *)(file.data() + header->dependencyOffset);
+        for (size_t i = 0; i < stamps.size(); i++)
+        {
+            if (deps[i].size != stamps[i].size || deps[i].mtime != stamps[i].mtime)
+                return fail();
+        }
+
+        // and every mesh must reference data inside the vertex/index blocks
+        uint64_t vertexCapacity = (header->indexOffset - header->vertexOffset) / sizeof(Vertex);
+        uint64_t indexCapacity = (header->stringOffset - header->indexOffset) / sizeof(unsigned int);
+        for (uint32_t i = 0; i < header->meshCount; i++)
+        {
+            const MeshCacheMeshRecord &record = mesh(i);
+            if (record.firstVertex + record.vertexCount > vertexCapacity ||
+                record.lodCount > MESH_MAX_LODS - 1 ||
+                record.firstIndex + MeshCacheIndexCount(record) > indexCapacity ||
+                (uint64_t)record.firstTexture + record.textureCount > header->textureCount)
+                return fail();
+        }
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        header = nullptr;
+    }
+
+    uint32_t meshCount() const { return header ? header->meshCount : 0; }
+    uint64_t fileSize() const { return header ? header->fileSize : 0; }
+    uint32_t boneCount() const { return header ? header->boneCount : 0; }
+
+    const MeshCacheMeshRecord &mesh(uint32_t i) const
+    {
+        return ((const MeshCacheMeshRecord *)(file.data() + header->meshOffset))[i];
+    }
+    const Vertex *vertices(const MeshCacheMeshRecord &record) const
+    {
+        return (const Vertex *)(file.data() + header->vertexOffset) + record.firstVertex;
+    }
+    const unsigned int *indices(const MeshCacheMeshRecord &record) const
+    {
+        return (const unsigned int *)(file.data() + header->indexOffset) + record.firstIndex;
+    }
+    // type ("texture_diffuse", ...) and path of the i-th texture of a mesh
+    bool texture(const MeshCacheMeshRecord &record, uint32_t i, string &type, string &path) const
+    {
+        const MeshCacheTextureRecord &tex = ((const MeshCacheTextureRecord *)(file.data() + header->textureOffset))[record.firstTexture + i];
+        return readString(tex.typeOffset, tex.typeLength, type) && readString(tex.pathOffset, tex.pathLength, path);
+    }
+    bool bone(uint32_t i, MeshCacheBone &out) const
+    {
+        const MeshCacheBoneRecord &rec = ((const MeshCacheBoneRecord *)(file.data() + header->boneOffset))[i];
+        out.id = rec.id;
+        memcpy(&out.offset[0][0], rec.offset, sizeof(rec.offset));
+        return readString(rec.nameOffset, rec.nameLength, out.name);
+    }
+
+    // writes the cache for 'sourcePath' from already converted meshes. the file is written under a temporary
+    // name and then renamed so a crash half way never leaves a truncated cache behind.
+    static bool Write(const string &sourcePath, uint32_t importFlags, uint32_t processFlags, const vector<Mesh> &meshes, const vector<MeshCacheBone> &bones)
+    {
+        vector<FileStamp> stamps;
+        if (!currentStamps(sourcePath, stamps))
+            return false;
+
+        vector<MeshCacheMeshRecord> meshRecords;
+        vector<MeshCacheTextureRecord> textureRecords;
+        vector<MeshCacheBoneRecord> boneRecords;
+        string strings;
+        uint64_t vertexCount = 0, indexCount = 0;
+
+        for (const Mesh &m : meshes)
+        {
+            MeshCacheMeshRecord record;
+            record.firstVertex = vertexCount;
+            record.firstIndex = indexCount;
+            record.vertexCount = (uint32_t)m.vertices.size();
+            record.indexCount = (uint32_t)m.indices.size();
+            record.firstTexture = (uint32_t)textureRecords.size();
+            record.textureCount = (uint32_t)m.textures.size();
+            memset(record.lodIndexCount, 0, sizeof(record.lodIndexCount));
+            record.lodCount = (uint32_t)min(m.lods.size(), (size_t)(MESH_MAX_LODS - 1));
+            for (uint32_t l = 0; l < record.lodCount; l++)
+                record.lodIndexCount[l] = (uint32_t)m.lods[l].indices.size();
+            for (const Texture &t : m.textures)
+            {
+                MeshCacheTextureRecord tex;
+                tex.typeOffset = addString(strings, t.type, tex.typeLength);
+                tex.pathOffset = addString(strings, t.path, tex.pathLength);
+                textureRecords.push_back(tex);
+            }
+            meshRecords.push_back(record);
+            vertexCount += m.vertices.size();
+            indexCount += MeshCacheIndexCount(record);
+        }
+        for (const MeshCacheBone &b : bones)
+        {
+            MeshCacheBoneRecord rec;
+            rec.nameOffset = addString(strings, b.name, rec.nameLength);
+            rec.id = b.id;
+            rec.padding = 0;
+            memcpy(rec.offset, &b.offset[0][0], sizeof(rec.offset));
+            boneRecords.push_back(rec);
+        }
+
+        MeshCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = MESH_CACHE_MAGIC;
+        header.version = MESH_CACHE_VERSION;
+        header.vertexStride = sizeof(Vertex);
+        header.importFlags = importFlags;
+        header.processFlags = processFlags;
+        header.dependencyCount = (uint32_t)stamps.size();
+        header.meshCount = (uint32_t)meshRecords.size();
+        header.textureCount = (uint32_t)textureRecords.size();
+        header.boneCount = (uint32_t)boneRecords.size();
+
+        uint64_t offset = align(sizeof(MeshCacheHeader));
+        header.dependencyOffset = offset; offset = align(offset + stamps.size() * sizeof(MeshCacheDependency));
+        header.meshOffset = offset;       offset = align(offset + meshRecords.size() * sizeof(MeshCacheMeshRecord));
+        header.textureOffset = offset;    offset = align(offset + textureRecords.size() * sizeof(MeshCacheTextureRecord));
+        header.boneOffset = offset;       offset = align(offset + boneRecords.size() * sizeof(MeshCacheBoneRecord));
+        header.vertexOffset = offset;     offset = align(offset + vertexCount * sizeof(Vertex));
+        header.indexOffset = offset;      offset = align(offset + indexCount * sizeof(unsigned int));
+        header.stringOffset = offset;     offset = offset + strings.size();
+        header.fileSize = offset;
+
+        vector<char> image((size_t)header.fileSize, 0);
+        memcpy(&image[0], &header, sizeof(header));
+        for (size_t i = 0; i < stamps.size(); i++)
+        {
+            MeshCacheDependency dep;
+            dep.size = stamps[i].size;
+            dep.mtime = stamps[i].mtime;
+            memcpy(&image[(size_t)header.dependencyOffset + i * sizeof(dep)], &dep, sizeof(dep));
+        }
+        copyArray(image, header.meshOffset, meshRecords);
+        copyArray(image, header.textureOffset, textureRecords);
+        copyArray(image, header.boneOffset, boneRecords);
+        size_t vertexCursor = (size_t)header.vertexOffset;
+        size_t indexCursor = (size_t)header.indexOffset;
+        for (const Mesh &m : meshes)
+        {
+            if (!m.vertices.empty())
+                memcpy(&image[vertexCursor], &m.vertices[0], m.vertices.size() * sizeof(Vertex));
+            if (!m.indices.empty())
+                memcpy(&image[indexCursor], &m.indices[0], m.indices.size() * sizeof(unsigned int));
+            vertexCursor += m.vertices.size() * sizeof(Vertex);
+            indexCursor += m.indices.size() * sizeof(unsigned int);
+            for (size_t l = 0; l < m.lods.size() && l < MESH_MAX_LODS - 1; l++)
+            {
+                const vector<unsigned int> &lod = m.lods[l].indices;
+                if (!lod.empty())
+                    memcpy(&image[indexCursor], &lod[0], lod.size() * sizeof(unsigned int));
+                indexCursor += lod.size() * sizeof(unsigned int);
+            }
+        }
+        if (!strings.empty())
+            memcpy(&image[(size_t)header.stringOffset], strings.data(), strings.size());
+
+        string cachePath = CachePath(sourcePath);
+        string tempPath = cachePath + ".tmp";
+        {
+            ofstream out(tempPath.c_str(), ios::binary | ios::trunc);
+            if (!out)
+            {
+                cout << "WARNING::MESH_CACHE:: could not write " << tempPath << endl;
+                return false;
+            }
+            out.write(&image[0], (streamsize)image.size());
+            if (!out)
+            {
+                out.close();
+                remove(tempPath.c_str());
+                return false;
+            }
+        }
+        remove(cachePath.c_str());
+        if (rename(tempPath.c_str(), cachePath.c_str()) != 0)
+        {
+            remove(tempPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    MappedFile file;
+    const MeshCacheHeader *header = nullptr;
+
+    bool fail()
+    {
+        close();
+        return false;
+    }
+
+    bool inside(uint64_t offset, uint64_t bytes) const
+    {
+        return offset <= header->fileSize && bytes <= header->fileSize - offset;
+    }
+
+    bool readString(uint32_t offset, uint32_t length, string &out) const
+    {
+        if ((uint64_t)offset + length > header->fileSize - header->stringOffset)
+            return false;
+        out.assign((const char *)file.data() + header->stringOffset + offset, length);
+        return true;
+    }
+
+    static bool currentStamps(const string &sourcePath, vector<FileStamp> &stamps)
+    {
+        vector<string> files = Dependencies(sourcePath);
+        stamps.resize(files.size());
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (!GetAssetStamp(files[i], stamps[i]))
+                return false;
+        }
+        return true;
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 15) & ~(uint64_t)15;
+    }
+
+    static uint32_t addString(string &table, const string &s, uint32_t &length)
+    {
+        uint32_t offset = (uint32_t)table.size();
+        table += s;
+        length = (uint32_t)s.size();
+        return offset;
+    }
+
+    template <typename T>
+    static void copyArray(vector<char> &image, uint64_t offset, const vector<T> &items)
+    {
+        if (!items.empty())
+            memcpy(&image[(size_t)offset], &items[0], items.size() * sizeof(T));
+    }
+};
+#endif
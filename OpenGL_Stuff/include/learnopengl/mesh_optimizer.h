@@ -0,0 +1,373 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/scratch_arena.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Import-time optimization of indexed triangle lists, run between the importer and Mesh creation:
+//   1. weld       - merge vertices that are bit-for-bit identical
+//   2. cache      - reorder triangles for the post-transform vertex cache (Forsyth)
+//   3. overdraw   - reorder clusters of the cache-ordered triangles so outward-facing ones draw first (Tipsify style)
+//   4. fetch      - renumber vertices in first-use order so vertex fetch walks memory linearly
+// ACMR (average cache miss ratio) is transformed vertices per triangle with a FIFO cache; 3.0 is
+// the worst, ~0.5-0.7 is typical for well ordered meshes.
+// Working tables live in the thread's ScratchArena; only the results are heap vectors.
+
+// size of the FIFO cache used to measure ACMR
+const unsigned int MESH_OPTIMIZER_CACHE_SIZE = 16;
+
+struct MeshOptimizationStats {
+    unsigned int verticesBefore = 0;
+    unsigned int verticesAfter = 0;
+    unsigned int triangles = 0;
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
+};
+
+// simulates a FIFO post-transform cache of 'cacheSize' entries and returns misses per triangle
+inline float AverageCacheMissRatio(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                   unsigned int cacheSize = MESH_OPTIMIZER_CACHE_SIZE)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+    // each vertex remembers the miss counter when it entered the cache; it is still cached while
+    // fewer than 'cacheSize' misses happened since
+    ScratchScope scratch;
+    ScratchVector<unsigned int> insertedAt(vertexCount, 0, scratch);
+    ScratchVector<bool> seen(vertexCount, false, scratch);
+    unsigned int misses = 0;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int v = indices[i];
+        if (!seen[v] || misses - insertedAt[v] >= cacheSize)
+        {
+            seen[v] = true;
+            insertedAt[v] = misses;
+            misses++;
+        }
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+// merges identical vertices and rewrites 'indices' to use the survivors. returns the new vertex count.
+inline size_t WeldVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    struct VertexHash {
+        size_t operator()(const Vertex &v) const
+        {
+            // FNV-1a over the raw bytes; Vertex is all floats, so it has no padding
+            const unsigned char *bytes = (const unsigned char *)&v;
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(Vertex); i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            return (size_t)hash;
+        }
+    };
+    struct VertexEqual {
+        bool operator()(const Vertex &a, const Vertex &b) const { return memcmp(&a, &b, sizeof(Vertex)) == 0; }
+    };
+
+    typedef std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual,
+                               ScratchAllocator<std::pair<const Vertex, unsigned int>>> VertexTable;
+    ScratchScope scratch;
+    VertexTable unique(vertices.size(), VertexHash(), VertexEqual(), scratch);
+    ScratchVector<unsigned int> remap(vertices.size(), scratch);
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        std::pair<VertexTable::iterator, bool> inserted =
+            unique.insert(std::make_pair(vertices[i], (unsigned int)welded.size()));
+        if (inserted.second)
+            welded.push_back(vertices[i]);
+        remap[i] = inserted.first->second;
+    }
+    for (size_t i = 0; i < indices.size(); i++)
+        indices[i] = remap[indices[i]];
+    vertices.swap(welded);
+    return vertices.size();
+}
+
+// Tom Forsyth's "linear-speed vertex cache optimisation": greedily emits the triangle with the
+// best score, where vertices score higher the more recently they were used and the fewer
+// triangles they have left.
+inline void OptimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount)
+{
+    const int CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    struct VertexState {
+        int cachePosition = -1;
+        unsigned int remaining = 0;   // triangles not emitted yet
+        unsigned int firstTriangle = 0;
+        float score = 0.0f;
+    };
+    ScratchScope scratch;
+    ScratchVector<VertexState> state(vertexCount, scratch);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        state[indices[i]].remaining++;
+
+    // triangles of every vertex, packed: vertexTriangles[firstTriangle .. firstTriangle + count)
+    ScratchVector<unsigned int> vertexTriangles(triangleCount * 3, scratch);
+    ScratchVector<unsigned int> fill(vertexCount, 0, scratch);
+    unsigned int offset = 0;
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        state[v].firstTriangle = offset;
+        offset += state[v].remaining;
+    }
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = indices[t * 3 + k];
+            vertexTriangles[state[v].firstTriangle + fill[v]++] = (unsigned int)t;
+        }
+    // while optimizing, 'fill' holds the number of triangles still listed for each vertex
+    // (emitted triangles are swapped to the end of the vertex's range)
+
+    auto vertexScore = [&](const VertexState &vertex) -> float
+    {
+        if (vertex.remaining == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (vertex.cachePosition >= 0)
+        {
+            if (vertex.cachePosition < 3)
+                score = LAST_TRIANGLE_SCORE;
+            else
+                score = powf(1.0f - (float)(vertex.cachePosition - 3) / (float)(CACHE_SIZE - 3), CACHE_DECAY_POWER);
+        }
+        return score + VALENCE_BOOST_SCALE * powf((float)vertex.remaining, -VALENCE_BOOST_POWER);
+    };
+
+    for (size_t v = 0; v < vertexCount; v++)
+        state[v].score = vertexScore(state[v]);
+    ScratchVector<float> triangleScore(triangleCount, scratch);
+    ScratchVector<bool> emitted(triangleCount, false, scratch);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = state[indices[t * 3]].score + state[indices[t * 3 + 1]].score + state[indices[t * 3 + 2]].score;
+
+    std::vector<unsigned int> result;
+    result.reserve(triangleCount * 3);
+    // the LRU never holds more than CACHE_SIZE + 3 entries
+    ScratchVector<unsigned int> cache(scratch), nextCache(scratch);
+    cache.reserve(CACHE_SIZE + 3);
+    nextCache.reserve(CACHE_SIZE + 3);
+    size_t scanCursor = 0;
+    int best = -1;
+    for (size_t t = 0; t < triangleCount; t++)
+        if (best < 0 || triangleScore[t] > triangleScore[best])
+            best = (int)t;
+
+    while (best >= 0)
+    {
+        emitted[best] = true;
+        unsigned int tri[3] = { indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2] };
+        for (int k = 0; k < 3; k++)
+        {
+            result.push_back(tri[k]);
+            VertexState &vertex = state[tri[k]];
+            vertex.remaining--;
+            // take the emitted triangle out of the vertex's live list
+            unsigned int *list = &vertexTriangles[vertex.firstTriangle];
+            for (unsigned int i = 0; i < fill[tri[k]]; i++)
+                if (list[i] == (unsigned int)best)
+                {
+                    std::swap(list[i], list[fill[tri[k]] - 1]);
+                    fill[tri[k]]--;
+                    break;
+                }
+        }
+
+        // LRU update: the triangle's vertices go to the front, the rest shift back
+        nextCache.assign(tri, tri + 3);
+        for (size_t i = 0; i < cache.size(); i++)
+            if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+                nextCache.push_back(cache[i]);
+        for (size_t i = 0; i < nextCache.size(); i++)
+            state[nextCache[i]].cachePosition = i < (size_t)CACHE_SIZE ? (int)i : -1;
+
+        // rescore the vertices that moved and the triangles that use them, and pick the best of those
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            unsigned int v = nextCache[i];
+            float newScore = vertexScore(state[v]);
+            float delta = newScore - state[v].score;
+            state[v].score = newScore;
+            const unsigned int *list = &vertexTriangles[state[v].firstTriangle];
+            for (unsigned int j = 0; j < fill[v]; j++)
+                triangleScore[list[j]] += delta;
+        }
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            unsigned int v = nextCache[i];
+            const unsigned int *list = &vertexTriangles[state[v].firstTriangle];
+            for (unsigned int j = 0; j < fill[v]; j++)
+                if (triangleScore[list[j]] > bestScore)
+                {
+                    bestScore = triangleScore[list[j]];
+                    best = (int)list[j];
+                }
+        }
+        if (nextCache.size() > (size_t)CACHE_SIZE)
+            nextCache.resize(CACHE_SIZE);
+        cache.swap(nextCache);
+
+        // nothing left around the cache: continue with the next triangle in input order
+        if (best < 0)
+        {
+            while (scanCursor < triangleCount && emitted[scanCursor])
+                scanCursor++;
+            if (scanCursor < triangleCount)
+                best = (int)scanCursor;
+        }
+    }
+    indices.swap(result);
+}
+
+// Reorders the cache-optimized triangle list to reduce overdraw (Sander et al. "Fast triangle
+// reordering for vertex locality and reduced overdraw"). The list is cut into clusters wherever
+// the FIFO cache restarts, and clusters are sorted so the ones facing away from the mesh centre
+// are drawn first. The result is kept only if ACMR stays within 'threshold' of the input.
+inline void OptimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices, float threshold = 1.05f)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // cluster starts: triangles whose three vertices all missed the cache
+    ScratchScope scratch;
+    ScratchVector<size_t> clusterStart(scratch);
+    clusterStart.reserve(triangleCount);
+    {
+        ScratchVector<unsigned int> insertedAt(vertices.size(), 0, scratch);
+        ScratchVector<bool> seen(vertices.size(), false, scratch);
+        unsigned int misses = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            int triangleMisses = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[t * 3 + k];
+                if (!seen[v] || misses - insertedAt[v] >= MESH_OPTIMIZER_CACHE_SIZE)
+                {
+                    seen[v] = true;
+                    insertedAt[v] = misses++;
+                    triangleMisses++;
+                }
+            }
+            if (t == 0 || triangleMisses == 3)
+                clusterStart.push_back(t);
+        }
+    }
+    if (clusterStart.size() < 2)
+        return;
+
+    glm::vec3 meshCentre(0.0f);
+    for (size_t i = 0; i < vertices.size(); i++)
+        meshCentre += vertices[i].Position;
+    meshCentre /= (float)vertices.size();
+
+    struct Cluster {
+        size_t first, count;
+        float sortKey;
+    };
+    ScratchVector<Cluster> clusters(scratch);
+    clusters.reserve(clusterStart.size());
+    for (size_t c = 0; c < clusterStart.size(); c++)
+    {
+        Cluster cluster;
+        cluster.first = clusterStart[c];
+        cluster.count = (c + 1 < clusterStart.size() ? clusterStart[c + 1] : triangleCount) - cluster.first;
+
+        // area weighted centroid and normal of the cluster
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = cluster.first; t < cluster.first + cluster.count; t++)
+        {
+            const glm::vec3 &a = vertices[indices[t * 3]].Position;
+            const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3 &c3 = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 n = glm::cross(b - a, c3 - a);
+            float triangleArea = glm::length(n);
+            centroid += (a + b + c3) * (triangleArea / 3.0f);
+            normal += n;
+            area += triangleArea;
+        }
+        if (area > 0.0f)
+            centroid /= area;
+        float normalLength = glm::length(normal);
+        // clusters that face outward are likely to occlude the rest, so they go first
+        cluster.sortKey = normalLength > 0.0f ? glm::dot(centroid - meshCentre, normal / normalLength) : 0.0f;
+        clusters.push_back(cluster);
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+                     [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c = 0; c < clusters.size(); c++)
+        result.insert(result.end(), indices.begin() + clusters[c].first * 3,
+                      indices.begin() + (clusters[c].first + clusters[c].count) * 3);
+
+    if (AverageCacheMissRatio(result, vertices.size()) <= AverageCacheMissRatio(indices, vertices.size()) * threshold)
+        indices.swap(result);
+}
+
+// renumbers vertices in the order the index buffer first references them and drops unused ones
+inline void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    const unsigned int UNUSED = 0xFFFFFFFFu;
+    ScratchScope scratch;
+    ScratchVector<unsigned int> remap(vertices.size(), UNUSED, scratch);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        unsigned int &target = remap[indices[i]];
+        if (target == UNUSED)
+        {
+            target = (unsigned int)ordered.size();
+            ordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = target;
+    }
+    vertices.swap(ordered);
+}
+
+// full pipeline: weld, vertex cache, overdraw, vertex fetch
+inline MeshOptimizationStats OptimizeMesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+{
+    MeshOptimizationStats stats;
+    stats.verticesBefore = (unsigned int)vertices.size();
+    stats.triangles = (unsigned int)(indices.size() / 3);
+    stats.acmrBefore = AverageCacheMissRatio(indices, vertices.size());
+
+    WeldVertices(vertices, indices);
+    OptimizeVertexCache(indices, vertices.size());
+    OptimizeOverdraw(indices, vertices);
+    OptimizeVertexFetch(vertices, indices);
+
+    stats.verticesAfter = (unsigned int)vertices.size();
+    stats.acmrAfter = AverageCacheMissRatio(indices, vertices.size());
+    return stats;
+}
+#endif
@@ -0,0 +1,267 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/scratch_arena.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// Edge-collapse simplification with quadric error metrics (Garland & Heckbert), used to build the
+// LOD chain of a Mesh at import time. Collapses move a vertex onto one of its neighbours, so every
+// level reuses the vertex buffer of the full mesh and only needs its own index list.
+// Vertices on open borders and on attribute seams (several vertices at one position, e.g. uv seams)
+// never move, which keeps the silhouette closed and the textures attached.
+
+// fraction of the full mesh's triangles each LOD level aims for
+const float MESH_LOD_RATIOS[MESH_MAX_LODS - 1] = { 0.5f, 0.25f, 0.125f };
+
+namespace mesh_simplifier_detail
+{
+    // symmetric 4x4 quadric, upper triangle only
+    struct Quadric {
+        double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+        void addPlane(const glm::dvec3 &n, double d, double weight)
+        {
+            a2 += weight * n.x * n.x; ab += weight * n.x * n.y; ac += weight * n.x * n.z; ad += weight * n.x * d;
+            b2 += weight * n.y * n.y; bc += weight * n.y * n.z; bd += weight * n.y * d;
+            c2 += weight * n.z * n.z; cd += weight * n.z * d;
+            d2 += weight * d * d;
+        }
+
+        void add(const Quadric &q)
+        {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2;
+            bc += q.bc; bd += q.bd; c2 += q.c2; cd += q.cd; d2 += q.d2;
+        }
+
+        // squared distance (area weighted) of 'p' to the planes accumulated in the quadric
+        double error(const glm::vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                     + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                     + c2 * z * z + 2 * cd * z + d2;
+            return e > 0.0 ? e : 0.0;
+        }
+    };
+
+    struct Collapse {
+        unsigned int from, to;
+        double cost;
+    };
+
+    struct PositionHash {
+        size_t operator()(const glm::vec3 &p) const
+        {
+            unsigned int h[3];
+            memcpy(h, &p, sizeof(h));
+            return (size_t)(h[0] * 73856093u ^ h[1] * 19349663u ^ h[2] * 83492791u);
+        }
+    };
+}
+
+// simplifies 'indices' towards 'targetIndexCount' indices
+inline std::vector<unsigned int> SimplifyMesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                              size_t targetIndexCount)
+{
+    using namespace mesh_simplifier_detail;
+    std::vector<unsigned int> result = indices;
+    size_t vertexCount = vertices.size();
+    if (vertexCount == 0 || indices.size() <= targetIndexCount)
+        return result;
+
+    // working tables come from the thread's scratch arena and go away with this scope
+    ScratchScope scratch;
+
+    // vertices sharing a position form one class: they share a quadric and, if there is more
+    // than one of them, sit on a seam
+    ScratchVector<unsigned int> positionClass(vertexCount, scratch);
+    ScratchVector<unsigned int> classSize(scratch);
+    classSize.reserve(vertexCount);
+    {
+        typedef std::unordered_map<glm::vec3, unsigned int, PositionHash, std::equal_to<glm::vec3>,
+                                   ScratchAllocator<std::pair<const glm::vec3, unsigned int>>> ClassTable;
+        ClassTable classes(vertexCount, PositionHash(), std::equal_to<glm::vec3>(), scratch);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            std::pair<ClassTable::iterator, bool> inserted =
+                classes.insert(std::make_pair(vertices[v].Position, (unsigned int)classSize.size()));
+            if (inserted.second)
+                classSize.push_back(0);
+            positionClass[v] = inserted.first->second;
+            classSize[positionClass[v]]++;
+        }
+    }
+
+    ScratchVector<bool> locked(vertexCount, false, scratch);
+    for (size_t v = 0; v < vertexCount; v++)
+        locked[v] = classSize[positionClass[v]] > 1;
+
+    // border edges (used by a single triangle, compared by position) lock both their ends
+    {
+        std::unordered_map<unsigned long long, unsigned int, std::hash<unsigned long long>, std::equal_to<unsigned long long>,
+                           ScratchAllocator<std::pair<const unsigned long long, unsigned int>>>
+            edgeUse(result.size(), std::hash<unsigned long long>(), std::equal_to<unsigned long long>(), scratch);
+        for (size_t i = 0; i + 2 < result.size(); i += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = positionClass[result[i + k]], b = positionClass[result[i + (k + 1) % 3]];
+                unsigned long long key = a < b ? ((unsigned long long)a << 32 | b) : ((unsigned long long)b << 32 | a);
+                edgeUse[key]++;
+            }
+        for (size_t i = 0; i + 2 < result.size(); i += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int va = result[i + k], vb = result[i + (k + 1) % 3];
+                unsigned int a = positionClass[va], b = positionClass[vb];
+                unsigned long long key = a < b ? ((unsigned long long)a << 32 | b) : ((unsigned long long)b << 32 | a);
+                if (edgeUse[key] == 1)
+                    locked[va] = locked[vb] = true;
+            }
+    }
+
+    // quadrics from the planes of the original triangles, per position class
+    ScratchVector<Quadric> quadrics(classSize.size(), scratch);
+    for (size_t i = 0; i + 2 < result.size(); i += 3)
+    {
+        glm::dvec3 p0(vertices[result[i]].Position), p1(vertices[result[i + 1]].Position), p2(vertices[result[i + 2]].Position);
+        glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(n);
+        if (length <= 0.0)
+            continue;
+        n /= length;
+        double area = length * 0.5;
+        for (int k = 0; k < 3; k++)
+            quadrics[positionClass[result[i + k]]].addPlane(n, -glm::dot(n, p0), area);
+    }
+
+    ScratchVector<unsigned int> remap(vertexCount, scratch);
+    ScratchVector<bool> dirty(vertexCount, false, scratch);
+    ScratchVector<unsigned int> triangleStart(vertexCount + 1, scratch), vertexTriangles(scratch), cursor(scratch);
+    ScratchVector<Collapse> candidates(scratch);
+    // sized for the first pass; later passes only shrink
+    vertexTriangles.reserve(result.size());
+    cursor.reserve(vertexCount);
+    candidates.reserve(result.size() * 2);
+
+    while (result.size() > targetIndexCount)
+    {
+        size_t triangleCount = result.size() / 3;
+
+        // triangles around every vertex, for the flip test
+        std::fill(triangleStart.begin(), triangleStart.end(), 0);
+        for (size_t i = 0; i < result.size(); i++)
+            triangleStart[result[i] + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            triangleStart[v + 1] += triangleStart[v];
+        vertexTriangles.assign(result.size(), 0);
+        cursor.assign(triangleStart.begin(), triangleStart.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+            vertexTriangles[cursor[result[i]]++] = (unsigned int)(i / 3);
+
+        candidates.clear();
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[t * 3 + k], b = result[t * 3 + (k + 1) % 3];
+                if (!locked[a])
+                    candidates.push_back(Collapse{ a, b, quadrics[positionClass[a]].error(vertices[b].Position) });
+                if (!locked[b])
+                    candidates.push_back(Collapse{ b, a, quadrics[positionClass[b]].error(vertices[a].Position) });
+            }
+        if (candidates.empty())
+            break;
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+        for (size_t v = 0; v < vertexCount; v++)
+            remap[v] = (unsigned int)v;
+        std::fill(dirty.begin(), dirty.end(), false);
+
+        // every collapse removes about two triangles
+        size_t collapsesWanted = (result.size() - targetIndexCount) / 6 + 1;
+        size_t collapses = 0;
+        for (size_t c = 0; c < candidates.size() && collapses < collapsesWanted; c++)
+        {
+            const Collapse &collapse = candidates[c];
+            if (dirty[collapse.from] || dirty[collapse.to])
+                continue;
+
+            // moving 'from' onto 'to' must not flip or degenerate any triangle that survives
+            bool valid = true;
+            const glm::vec3 &target = vertices[collapse.to].Position;
+            for (unsigned int j = triangleStart[collapse.from]; j < triangleStart[collapse.from + 1] && valid; j++)
+            {
+                const unsigned int *tri = &result[vertexTriangles[j] * 3];
+                if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+                    continue;
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    before[k] = vertices[tri[k]].Position;
+                    after[k] = tri[k] == collapse.from ? target : before[k];
+                }
+                glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(n0, n1) <= 0.0f)
+                    valid = false;
+            }
+            if (!valid)
+                continue;
+
+            remap[collapse.from] = collapse.to;
+            quadrics[positionClass[collapse.to]].add(quadrics[positionClass[collapse.from]]);
+            // the neighbourhood changed, so nothing around it collapses again in this pass
+            for (unsigned int j = triangleStart[collapse.from]; j < triangleStart[collapse.from + 1]; j++)
+            {
+                const unsigned int *tri = &result[vertexTriangles[j] * 3];
+                dirty[tri[0]] = dirty[tri[1]] = dirty[tri[2]] = true;
+            }
+            collapses++;
+        }
+        if (collapses == 0)
+            break;
+
+        // apply the collapses and drop the triangles that became degenerate
+        size_t write = 0;
+        for (size_t i = 0; i + 2 < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+    return result;
+}
+
+// builds up to MESH_MAX_LODS - 1 coarser levels for an (already optimized) mesh. levels that
+// can't get meaningfully smaller than the previous one (e.g. a mesh made only of seams) end the chain.
+inline void GenerateMeshLods(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, std::vector<MeshLod> &lods)
+{
+    lods.clear();
+    lods.reserve(MESH_MAX_LODS - 1);   // 'previous' points into it
+    const std::vector<unsigned int> *previous = &indices;
+    for (int level = 0; level < MESH_MAX_LODS - 1; level++)
+    {
+        size_t target = (size_t)(indices.size() / 3 * MESH_LOD_RATIOS[level]) * 3;
+        MeshLod lod;
+        lod.indices = SimplifyMesh(vertices, *previous, target);
+        if (lod.indices.empty() || lod.indices.size() > previous->size() * 9 / 10)
+            break;
+        OptimizeVertexCache(lod.indices, vertices.size());
+        lods.push_back(std::move(lod));
+        previous = &lods.back().indices;
+    }
+}
+#endif
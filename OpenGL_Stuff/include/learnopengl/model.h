@@ -10,59 +10,608 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/asset_pack_io.h>
+#include <learnopengl/gltf_loader.h>
+#include <learnopengl/instance_buffer.h>
+#include <learnopengl/load_profiler.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/texture_compress.h>
+#include <learnopengl/texture_pool.h>
+#include <learnopengl/texture_upload.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <future>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
+// post-processing steps requested from Assimp, for models that need every vertex attribute (see
+// Model::importFlags). stored in the mesh cache, so changing them invalidates every cache.
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromImage(const DecodedImage &image, bool gamma = false);
+
+// how a Model is loaded
+struct ModelLoadOptions {
+    bool gamma = false;
+    // import (file I/O, Assimp, image decoding) in the constructor but leave every GL call to
+    // UploadStep(), so the constructor can run on a loader thread without a GL context.
+    bool deferUpload = false;
+    // upload the meshes with the quantized PackedVertex layout and 16-bit indices where they fit.
+    // only for shaders that read quantizedPositions/positionScale/positionOffset (see scene.vs).
+    bool packVertices = false;
+    // weld and reorder every mesh for the vertex cache, overdraw and vertex fetch after the import
+    // (see mesh_optimizer.h). the optimized meshes are what the mesh cache stores.
+    bool optimizeMeshes = true;
+    // build up to MESH_MAX_LODS - 1 simplified levels per mesh (see mesh_simplifier.h). needs
+    // optimizeMeshes, the simplifier only collapses welded vertices.
+    bool generateLods = true;
+    // VERTEX_ATTRIB_* the shader drawing the model reads, usually Shader::ActiveAttributeMask().
+    // attributes left out aren't computed at import (no tangent space, no smooth normals) and a
+    // mesh without tangent/bitangent is uploaded with the smaller BasicVertex layouts. the mask is
+    // part of the mesh cache key; a model shared through the ModelRegistry keeps the mask of its first load.
+    unsigned int vertexAttributes = VERTEX_ATTRIBS_ALL;
+};
+
+// how Model::Draw picks the level of detail of each mesh
+struct LodSettings {
+    // projected size (bounding radius / distance to the camera) below which a mesh drops to level 1;
+    // every further halving drops one more level
+    float fullDetailSize = 0.5f;
+    // >= 0 draws every mesh at this level (clamped to the levels it has), to compare levels
+    int forcedLevel = -1;
+};
+
+inline LodSettings &ModelLodSettings()
+{
+    static LodSettings settings;
+    return settings;
+}
+
+// GPU memory held by a Model
+struct ModelMemoryUsage {
+    size_t       geometryBytes = 0;        // vertices and indices (all LOD levels) in the geometry arena
+    size_t       textureBytes = 0;         // every texture the model uses
+    size_t       sharedTextureBytes = 0;   // the part of textureBytes other models use too
+    unsigned int textures = 0;
+};
 
 class Model 
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// stores all the textures used by this model; the GL textures themselves are shared through the TextureCache.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // object space bounds of all the meshes (the union of their boxes, and a sphere holding their
+    // spheres), computed at import
+    glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCentre = glm::vec3(0.0f);
+    float     boundsRadius = 0.0f;
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
     {
-        loadModel(path);
+        ModelLoadOptions options;
+        options.gamma = gamma;
+        load(path, options);
+    }
+
+    Model(string const &path, const ModelLoadOptions &options) : gammaCorrection(options.gamma)
+    {
+        load(path, options);
     }
 
-    // draws the model, and thus all its meshes
+    // gives the shared textures back to the TextureCache, which deletes the ones nobody else uses,
+    // and the mesh ranges back to the geometry arena
+    ~Model()
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Release();
+        for(unsigned int i = 0; i < cachedTextureKeys.size(); i++)
+            TextureCache::Instance().Release(cachedTextureKeys[i]);
+    }
+
+    // a model owns references on cached textures, so it can't be copied
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
+    // draws the model, and thus all its meshes, at full detail (or the forced LOD level)
+    // meshes share arena VAOs, so consecutive meshes on the same page draw without a rebind.
     void Draw(Shader &shader)
+    {
+        drawMeshes(shader, nullptr, glm::vec3(0.0f));
+    }
+
+    // draws the model with a level of detail per mesh, chosen from its projected size as seen from
+    // 'viewPosition'. 'modelMatrix' must be the one the shader uses.
+    void Draw(Shader &shader, const glm::mat4 &modelMatrix, const glm::vec3 &viewPosition)
+    {
+        drawMeshes(shader, &modelMatrix, viewPosition);
+    }
+
+    // draws every copy in 'instances' with one instanced call per mesh. the shader must read the
+    // model matrix from the instance attributes (INSTANCE_MATRIX_ATTRIB). each mesh uses the
+    // level of detail its nearest copy needs.
+    void DrawInstanced(Shader &shader, const InstanceBuffer &instances, const glm::vec3 &viewPosition)
+    {
+        if(instances.Count() == 0)
+            return;
+        unsigned int boundVAO = 0;
+        TextureBindings bindings;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Mesh &mesh = meshes[i];
+            if(!mesh.IsUploaded())
+                continue;
+            mesh.BindTextures(shader, &bindings);
+            mesh.BindQuantization(shader);
+            if(mesh.VertexArray() != boundVAO)
+            {
+                if(boundVAO)
+                    InstanceBuffer::Detach();
+                boundVAO = mesh.VertexArray();
+                glBindVertexArray(boundVAO);
+                instances.Attach();
+            }
+            mesh.DrawElementsInstanced(SelectInstancedLod(mesh, instances.Matrices(), viewPosition), instances.Count());
+        }
+        if(boundVAO)
+            InstanceBuffer::Detach();
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    ModelMemoryUsage MemoryUsage() const
+    {
+        ModelMemoryUsage usage;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            if(meshes[i].IsUploaded())
+                usage.geometryBytes += meshes[i].UploadSize();
+        for(unsigned int i = 0; i < cachedTextureKeys.size(); i++)
+        {
+            size_t bytes = 0;
+            unsigned int users = 0;
+            if(!TextureCache::Instance().Lookup(cachedTextureKeys[i], bytes, users))
+                continue;
+            usage.textures++;
+            usage.textureBytes += bytes;
+            if(users > 1)
+                usage.sharedTextureBytes += bytes;
+        }
+        return usage;
+    }
+
+    // packs the textures of 'models' (nulls are skipped) into 'arrays' and frees the 2D originals,
+    // so a packed texture is in VRAM once. only textures that nothing else can sample are packed:
+    // every user in the TextureCache is one of 'models', and every mesh that uses one takes it as
+    // its first diffuse or specular texture, the ones Mesh::BindTextures reads from an array.
+    // the cache entries stay, so a model loaded later that needs one uploads it again. GL thread.
+    static void PackTextureArrays(const vector<Model*> &models, TextureArraySet &arrays)
+    {
+        // per cache key: how many of 'models' hold it and whether all of them only sample it from an array
+        struct Candidate {
+            unsigned int holders = 0;
+            bool arrayOnly = true;
+        };
+        map<string, Candidate> candidates;
+        for(size_t m = 0; m < models.size(); m++)
+        {
+            if(!models[m])
+                continue;
+            vector<bool> arrayOnly = models[m]->arrayOnlySlots();
+            for(size_t slot = 0; slot < models[m]->cachedTextureKeys.size(); slot++)
+            {
+                Candidate &candidate = candidates[models[m]->cachedTextureKeys[slot]];
+                candidate.holders++;
+                candidate.arrayOnly = candidate.arrayOnly && arrayOnly[slot];
+            }
+        }
+        for(map<string, Candidate>::iterator it = candidates.begin(); it != candidates.end(); ++it)
+        {
+            size_t bytes = 0;
+            unsigned int users = 0;
+            if(!it->second.arrayOnly || !TextureCache::Instance().Lookup(it->first, bytes, users) || users != it->second.holders)
+                it->second.arrayOnly = false;
+        }
+
+        for(size_t m = 0; m < models.size(); m++)
+            if(models[m])
+                for(size_t slot = 0; slot < models[m]->cachedTextureKeys.size(); slot++)
+                    if(candidates[models[m]->cachedTextureKeys[slot]].arrayOnly)
+                        arrays.Add(models[m]->textures_loaded[slot].id);
+        arrays.Build();
+        for(size_t m = 0; m < models.size(); m++)
+            if(models[m])
+                models[m]->UseTextureArrays(arrays);
+
+        // textures left out of every array (a size no other texture has) keep their 2D original
+        for(size_t m = 0; m < models.size(); m++)
+            if(models[m])
+                for(size_t slot = 0; slot < models[m]->cachedTextureKeys.size(); slot++)
+                {
+                    const string &key = models[m]->cachedTextureKeys[slot];
+                    if(candidates[key].arrayOnly && arrays.Find(models[m]->textures_loaded[slot].id).valid())
+                        TextureCache::Instance().DropTexture(key);
+                }
+    }
+
+    // points the meshes' textures at their layers in 'arrays', holding a reference on each layer
+    // until ReleaseTextureArrays()
+    void UseTextureArrays(TextureArraySet &arrays)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            for(unsigned int j = 0; j < meshes[i].textures.size(); j++)
+            {
+                Texture &texture = meshes[i].textures[j];
+                if(!texture.arrayLayer.valid())
+                    texture.arrayLayer = arrays.Acquire(texture.id);
+            }
+    }
+
+    // gives this model's layers back to 'arrays' when the model is about to be destroyed; layers
+    // other models still use stay
+    void ReleaseTextureArrays(TextureArraySet &arrays)
     {
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            for(unsigned int j = 0; j < meshes[i].textures.size(); j++)
+            {
+                Texture &texture = meshes[i].textures[j];
+                if(texture.arrayLayer.valid())
+                    arrays.Release(texture.id);
+                texture.arrayLayer = TextureArrayLayer();
+            }
+    }
+
+    // level Draw() uses for 'mesh' under 'modelMatrix'
+    static unsigned int SelectLod(const Mesh &mesh, const glm::mat4 &modelMatrix, const glm::vec3 &viewPosition)
+    {
+        const LodSettings &settings = ModelLodSettings();
+        if(settings.forcedLevel >= 0)
+            return (unsigned int)settings.forcedLevel;
+        if(mesh.LodCount() == 1)
+            return 0;
+
+        glm::vec3 centre = glm::vec3(modelMatrix * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+        float scale = glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+        float radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f * scale;
+        float distance = glm::length(centre - viewPosition) - radius;
+        if(distance <= 0.0f)
+            return 0;
+        float size = radius / distance;
+        if(size >= settings.fullDetailSize)
+            return 0;
+        return (unsigned int)glm::log2(settings.fullDetailSize / size) + 1;
+    }
+
+    // level an instanced draw uses for 'mesh': the finest any of the copies needs
+    static unsigned int SelectInstancedLod(const Mesh &mesh, const std::vector<glm::mat4> &modelMatrices, const glm::vec3 &viewPosition)
+    {
+        unsigned int lod = MESH_MAX_LODS;
+        for(size_t i = 0; i < modelMatrices.size() && lod > 0; i++)
+            lod = std::min(lod, SelectLod(mesh, modelMatrices[i], viewPosition));
+        return lod;
+    }
+
+    // does the GL part of the load (mesh buffers, then textures in request order) until roughly 'budget'
+    // bytes have been sent, and subtracts what it used. returns true once everything is on the GPU.
+    // textures go through the PixelUploadRing a band of rows at a time, so one large texture doesn't
+    // blow the budget of a frame. must run on the GL thread; always makes progress even with a zero
+    // budget, unless every staging buffer is still in flight.
+    bool UploadStep(size_t &budget)
+    {
+        bool first = true;
+        while(nextMeshUpload < meshes.size())
+        {
+            if(!first && budget == 0)
+                return false;
+            size_t bytes = meshes[nextMeshUpload].UploadSize();
+            {
+                LoadTimer timer(sourcePath, LOAD_STAGE_GL_UPLOAD, bytes);
+                meshes[nextMeshUpload++].Upload();
+            }
+            consumeUploadBudget(budget, bytes);
+            first = false;
+        }
+        while(nextTextureUpload < pendingTextures.size())
+        {
+            if(!first && budget == 0)
+                return false;
+            PendingTexture &pending = pendingTextures[nextTextureUpload];
+            Texture &texture = textures_loaded[pending.slot];
+            if(!pending.upload.Started())
+            {
+                // models imported side by side decode a shared texture each; the first to upload creates it
+                texture.id = TextureCache::Instance().Find(pending.key);
+                if(texture.id != 0)
+                {
+                    uploadBytesDone += pending.image.byteSize();
+                    pending.image.reset();
+                    nextTextureUpload++;
+                    continue;
+                }
+                size_t bytes = pending.image.byteSize();
+                bool isCompressed = pending.image.compressedFormat != 0;
+                // stored right away, so no other model uploads it again while the rows stream in;
+                // compressed images carry their whole mip chain, plain ones get roughly a third more from glGenerateMipmap
+                texture.id = pending.upload.Start(std::move(pending.image));
+                TextureCache::Instance().Store(pending.key, texture.id, isCompressed ? bytes : bytes * 4 / 3);
+            }
+            // a band of rows through the PBO ring; large textures take several steps (and frames)
+            consumeUploadBudget(budget, pending.upload.Step(budget));
+            first = false;
+            if(!pending.upload.Done())
+                return false;
+            nextTextureUpload++;
+        }
+        if(!uploaded)
+            resolveTextureIds();
+        return true;
     }
-    
+
+    bool IsUploaded() const { return uploaded; }
+
+    // fraction of the GL upload that is done, 0..1
+    float UploadProgress() const
+    {
+        return uploadBytesTotal == 0 ? (uploaded ? 1.0f : 0.0f) : (float)((double)uploadBytesDone / (double)uploadBytesTotal);
+    }
+
 private:
+    // texture decodes queued on the TextureDecodePool, waiting for their GL upload
+    struct PendingTexture {
+        size_t slot;                  // index into textures_loaded
+        string key;                   // TextureCache key the upload is stored under
+        future<DecodedImage> decode;
+        DecodedImage image;           // pixels, once the decode finished
+        TextureUpload upload;         // takes the pixels over when the upload starts
+    };
+    vector<PendingTexture> pendingTextures;
+    size_t nextMeshUpload = 0, nextTextureUpload = 0;
+    size_t uploadBytesTotal = 0, uploadBytesDone = 0;
+    bool uploaded = false;
+    unordered_map<string, size_t> textureSlots; // texture path as written in the material -> index into textures_loaded
+    vector<string> cachedTextureKeys;           // TextureCache references held by this model
+    bool optimizeMeshes = true;
+    bool generateLods = true;
+    // what the optimizer did to all the meshes, the ACMRs summed weighted by triangles. imports run
+    // on loader threads, so this is printed once from the GL thread when the upload finishes.
+    MeshOptimizationStats optimizationTotals;
+    unsigned int vertexAttributes = VERTEX_ATTRIBS_ALL;
+    string sourcePath;                          // what the LoadProfiler records this model's stages under
+
+    // slots of textures_loaded the meshes only sample as their first diffuse or specular texture
+    vector<bool> arrayOnlySlots() const
+    {
+        vector<bool> arrayOnly(textures_loaded.size(), false), used(textures_loaded.size(), false);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            unsigned int counts[MATERIAL_TEXTURE_KINDS] = { 0 };
+            for(unsigned int j = 0; j < meshes[i].textures.size(); j++)
+            {
+                const Texture &texture = meshes[i].textures[j];
+                unordered_map<string, size_t>::const_iterator slot = textureSlots.find(texture.path);
+                if(slot == textureSlots.end())
+                    continue;
+                int kind = GetMaterialTextureKind(texture.type);
+                unsigned int number = kind >= 0 ? ++counts[kind] : 0;
+                bool fromArray = number == 1 && (kind == MATERIAL_DIFFUSE || kind == MATERIAL_SPECULAR);
+                arrayOnly[slot->second] = fromArray && (arrayOnly[slot->second] || !used[slot->second]);
+                used[slot->second] = true;
+            }
+        }
+        return arrayOnly;
+    }
+
+    // draws every uploaded mesh; with a model matrix each mesh gets its own level of detail
+    void drawMeshes(Shader &shader, const glm::mat4 *modelMatrix, const glm::vec3 &viewPosition)
+    {
+        unsigned int boundVAO = 0;
+        TextureBindings bindings;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Mesh &mesh = meshes[i];
+            if(!mesh.IsUploaded())
+                continue;
+            mesh.BindTextures(shader, &bindings);
+            mesh.BindQuantization(shader);
+            if(mesh.VertexArray() != boundVAO)
+            {
+                boundVAO = mesh.VertexArray();
+                glBindVertexArray(boundVAO);
+            }
+            unsigned int lod = 0;
+            if(modelMatrix)
+                lod = SelectLod(mesh, *modelMatrix, viewPosition);
+            else if(ModelLodSettings().forcedLevel >= 0)
+                lod = (unsigned int)ModelLodSettings().forcedLevel;
+            mesh.DrawElements(lod);
+        }
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // imports the model and, unless deferred, uploads it right away
+    void load(string const &path, const ModelLoadOptions &options)
+    {
+        sourcePath = path;
+        optimizeMeshes = options.optimizeMeshes;
+        generateLods = options.generateLods && options.optimizeMeshes;
+        vertexAttributes = options.vertexAttributes;
+        loadModel(path);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            meshes[i].packed = options.packVertices;
+            meshes[i].attributes = vertexAttributes;
+        }
+        computeBounds();
+        collectTextureDecodes();
+        if(!options.deferUpload)
+        {
+            size_t unlimited = (size_t)-1;
+            UploadStep(unlimited);
+        }
+    }
+
+    void computeBounds()
+    {
+        if(meshes.empty())
+            return;
+        boundsMin = meshes[0].boundsMin;
+        boundsMax = meshes[0].boundsMax;
+        for(unsigned int i = 1; i < meshes.size(); i++)
+        {
+            boundsMin = glm::min(boundsMin, meshes[i].boundsMin);
+            boundsMax = glm::max(boundsMax, meshes[i].boundsMax);
+        }
+        boundsCentre = (boundsMin + boundsMax) * 0.5f;
+        boundsRadius = 0.0f;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            boundsRadius = std::max(boundsRadius, glm::length(meshes[i].boundsCentre - boundsCentre) + meshes[i].boundsRadius);
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // a valid mesh cache next to the file skips Assimp entirely; otherwise the cache is (re)written after the import.
+    // glTF files go through the direct loader (gltf_loader.h) and only fall back to Assimp if it can't read them.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        if(loadFromCache(path))
+            return;
+
+        if(IsGltfPath(path) && loadGltf(path))
+        {
+            MeshCache::Write(path, importFlags(), processFlags() | MESH_PROCESS_DIRECT_GLTF, meshes, vector<MeshCacheBone>());
+            return;
+        }
+
+        // read file via ASSIMP, from the asset pack if one is mounted
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        if(MountedAssetPack().isOpen())
+            importer.SetIOHandler(new AssetPackIOSystem());
+        const aiScene* scene;
+        {
+            FileStamp stamp;
+            LoadTimer timer(path, LOAD_STAGE_PARSE, GetAssetStamp(path, stamp) ? stamp.size : 0);
+            scene = importer.ReadFile(path, importFlags());
+        }
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
+        meshes.reserve(scene->mNumMeshes);
         processNode(scene->mRootNode, scene);
+
+        // this model has no skinning data, so the bone table of the cache stays empty
+        MeshCache::Write(path, importFlags(), processFlags(), meshes, vector<MeshCacheBone>());
+    }
+
+    // the Assimp steps the vertex attributes need: the tangent frame needs smooth normals as well
+    uint32_t importFlags() const
+    {
+        uint32_t flags = MODEL_IMPORT_FLAGS;
+        if(!(vertexAttributes & VERTEX_ATTRIBS_TANGENT_FRAME))
+        {
+            flags &= ~(uint32_t)aiProcess_CalcTangentSpace;
+            if(!(vertexAttributes & VERTEX_ATTRIB_NORMAL))
+                flags &= ~(uint32_t)aiProcess_GenSmoothNormals;
+        }
+        return flags;
+    }
+
+    // mesh cache flags for the post-import processing this model asks for
+    uint32_t processFlags() const
+    {
+        return (optimizeMeshes ? MESH_PROCESS_OPTIMIZED : 0) | (generateLods ? MESH_PROCESS_LODS : 0);
+    }
+
+    // imports a .gltf without Assimp. returns false, with nothing loaded, if the direct loader can't handle the file.
+    bool loadGltf(string const &path)
+    {
+        vector<GltfPrimitive> primitives;
+        string error;
+        if(!LoadGltf(path, primitives, error, vertexAttributes))
+        {
+            cout << "GLTF:: " << path << ": " << error << ", using Assimp" << endl;
+            return false;
+        }
+        meshes.reserve(primitives.size());
+        for(unsigned int i = 0; i < primitives.size(); i++)
+        {
+            GltfPrimitive &primitive = primitives[i];
+            vector<Texture> textures;
+            if(!primitive.diffuseTexture.empty())
+                textures.push_back(loadTexture(primitive.diffuseTexture.c_str(), "texture_diffuse"));
+            if(!primitive.specularTexture.empty())
+                textures.push_back(loadTexture(primitive.specularTexture.c_str(), "texture_specular"));
+            meshes.push_back(buildMesh(primitive.vertices, primitive.indices, textures));
+        }
+        return true;
+    }
+
+    // builds the meshes straight from the memory-mapped cache. returns false if there is no up to date cache.
+    bool loadFromCache(string const &path)
+    {
+        vector<vector<pair<string, string>>> meshTextures;   // type and path of every texture of each mesh
+        {
+            // the cache is mapped, so its pages are read while the meshes are copied out: that counts as file read
+            LoadTimer timer(path, LOAD_STAGE_FILE_READ);
+            MeshCache cache;
+            // a .gltf cache is valid whether the direct loader or the Assimp fallback wrote it
+            if(!cache.open(path, importFlags(), processFlags(), IsGltfPath(path) ? MESH_PROCESS_DIRECT_GLTF : 0))
+                return false;
+            timer.AddBytes(cache.fileSize());
+
+            meshes.reserve(cache.meshCount());
+            meshTextures.resize(cache.meshCount());
+            for(unsigned int i = 0; i < cache.meshCount(); i++)
+            {
+                const MeshCacheMeshRecord &record = cache.mesh(i);
+                const Vertex *v = cache.vertices(record);
+                const unsigned int *idx = cache.indices(record);
+                vector<Vertex> vertices(v, v + record.vertexCount);
+                vector<unsigned int> indices(idx, idx + record.indexCount);
+                // the LOD levels are stored right after the full index list
+                vector<MeshLod> lods(record.lodCount);
+                idx += record.indexCount;
+                for(unsigned int l = 0; l < record.lodCount; l++)
+                {
+                    lods[l].indices.assign(idx, idx + record.lodIndexCount[l]);
+                    idx += record.lodIndexCount[l];
+                }
+                for(unsigned int t = 0; t < record.textureCount; t++)
+                {
+                    string type, texturePath;
+                    if(cache.texture(record, t, type, texturePath))
+                        meshTextures[i].push_back(make_pair(type, texturePath));
+                }
+                meshes.push_back(Mesh(std::move(vertices), std::move(indices), vector<Texture>(), false));
+                meshes.back().lods.swap(lods);
+            }
+        }
+
+        // outside the timer: the texture loads record their own file reads
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            for(unsigned int t = 0; t < meshTextures[i].size(); t++)
+                meshes[i].textures.push_back(loadTexture(meshTextures[i][t].second.c_str(), meshTextures[i][t].first));
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -90,11 +639,16 @@ private:
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
+        LoadProfiler::Clock::time_point conversionStart = LoadProfiler::Clock::now();
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve((size_t)mesh->mNumFaces * 3);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
             Vertex vertex;
+            // attributes the import doesn't provide (or the shader doesn't read) stay zero
+            vertex.Normal = vertex.Tangent = vertex.Bitangent = glm::vec3(0.0f);
             glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -102,7 +656,7 @@ private:
             vector.z = mesh->mVertices[i].z;
             vertex.Position = vector;
             // normals
-            if (mesh->HasNormals())
+            if (mesh->HasNormals() && (vertexAttributes & (VERTEX_ATTRIB_NORMAL | VERTEX_ATTRIBS_TANGENT_FRAME)))
             {
                 vector.x = mesh->mNormals[i].x;
                 vector.y = mesh->mNormals[i].y;
@@ -110,7 +664,7 @@ private:
                 vertex.Normal = vector;
             }
             // texture coordinates
-            if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
+            if(mesh->mTextureCoords[0] && (vertexAttributes & (VERTEX_ATTRIB_TEXCOORDS | VERTEX_ATTRIBS_TANGENT_FRAME))) // does the mesh contain texture coordinates (and does the shader want them)?
             {
                 glm::vec2 vec;
                 // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
@@ -118,16 +672,18 @@ private:
                 vec.x = mesh->mTextureCoords[0][i].x; 
                 vec.y = mesh->mTextureCoords[0][i].y;
                 vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
+                // tangent and bitangent, only there when the import calculated the tangent space
+                if(mesh->HasTangentsAndBitangents())
+                {
+                    vector.x = mesh->mTangents[i].x;
+                    vector.y = mesh->mTangents[i].y;
+                    vector.z = mesh->mTangents[i].z;
+                    vertex.Tangent = vector;
+                    vector.x = mesh->mBitangents[i].x;
+                    vector.y = mesh->mBitangents[i].y;
+                    vector.z = mesh->mBitangents[i].z;
+                    vertex.Bitangent = vector;
+                }
             }
             else
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
@@ -142,6 +698,8 @@ private:
             for(unsigned int j = 0; j < face.mNumIndices; j++)
                 indices.push_back(face.mIndices[j]);        
         }
+        LoadProfiler::Instance().Record(sourcePath, LOAD_STAGE_VERTEX_CONVERSION, LoadProfiler::SecondsSince(conversionStart),
+                                        vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int), mesh->mNumVertices);
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
@@ -165,7 +723,30 @@ private:
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
         
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return buildMesh(vertices, indices, textures);
+    }
+
+    // the import steps shared by Assimp and the glTF loader: optimization and LODs, then the Mesh itself.
+    // 'vertices', 'indices' and 'textures' are moved into the mesh.
+    Mesh buildMesh(vector<Vertex> &vertices, vector<unsigned int> &indices, vector<Texture> &textures)
+    {
+        LoadTimer timer(sourcePath, LOAD_STAGE_MESH_PROCESSING, 0, vertices.size());
+        // weld duplicates and reorder for the GPU before the mesh is built
+        if(optimizeMeshes)
+        {
+            MeshOptimizationStats stats = OptimizeMesh(vertices, indices);
+            optimizationTotals.triangles += stats.triangles;
+            optimizationTotals.verticesBefore += stats.verticesBefore;
+            optimizationTotals.verticesAfter += stats.verticesAfter;
+            optimizationTotals.acmrBefore += stats.acmrBefore * stats.triangles;
+            optimizationTotals.acmrAfter += stats.acmrAfter * stats.triangles;
+        }
+        vector<MeshLod> lods;
+        if(generateLods)
+            GenerateMeshLods(vertices, indices, lods);
+        Mesh result(std::move(vertices), std::move(indices), std::move(textures), false);
+        result.lods.swap(lods);
+        return result;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -177,28 +758,97 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            textures.push_back(loadTexture(str.C_Str(), typeName));
+        }
+        return textures;
+    }
+
+    // returns the texture at 'path' (relative to the model directory), loading it only the first time it's requested
+    // by any model: textures already in the process-wide TextureCache are shared by GL handle.
+    Texture loadTexture(const char *path, const string &typeName)
+    {
+        // check if this model used the texture before and if so, reuse it
+        unordered_map<string, size_t>::const_iterator found = textureSlots.find(path);
+        if(found != textureSlots.end())
+            return textures_loaded[found->second];
+
+        Texture texture;
+        texture.type = typeName;
+        texture.path = path;
+        string filename = this->directory + '/' + texture.path;
+        // identified by content: the same image under another path or name shares the texture
+        string key = TextureCache::Instance().ContentKey(filename);
+        for(size_t i = 0; i < cachedTextureKeys.size(); i++)
+        {
+            if(cachedTextureKeys[i] != key)
+                continue;
+            // another name of an image this model already loads: same slot, same reference
+            TextureCache::Instance().AddAlias(key, filename);
+            textureSlots[texture.path] = i;
+            Texture shared = textures_loaded[i];
+            shared.type = typeName;
+            return shared;
+        }
+        cachedTextureKeys.push_back(key);
+        // queued on the decode pool unless the texture is already on the GPU: the first user in the
+        // process, or one whose owner is still loading (it may be importing on another thread, and
+        // whichever model uploads first creates the texture). the id stays 0 until UploadStep().
+        if(!TextureCache::Instance().Acquire(key, texture.id, filename) || texture.id == 0)
+        {
+            PendingTexture pending;
+            pending.slot = textures_loaded.size();
+            pending.key = key;
+            pending.decode = TextureDecodePool::Instance().Submit(filename, LoadTextureImage);
+            pendingTextures.push_back(std::move(pending));
+        }
+        textureSlots[texture.path] = textures_loaded.size();
+        textures_loaded.push_back(texture);
+        return texture;
+    }
+
+    // waits for the queued decodes (they run in parallel on the pool) and sizes the upload that's left
+    void collectTextureDecodes()
+    {
+        uploadBytesTotal = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            uploadBytesTotal += meshes[i].UploadSize();
+        for(unsigned int i = 0; i < pendingTextures.size(); i++)
+        {
+            pendingTextures[i].image = pendingTextures[i].decode.get();
+            uploadBytesTotal += pendingTextures[i].image.byteSize();
+        }
+    }
+
+    void consumeUploadBudget(size_t &budget, size_t bytes)
+    {
+        uploadBytesDone += bytes;
+        budget -= bytes < budget ? bytes : budget;
+    }
+
+    // hands the final texture ids to the meshes
+    void resolveTextureIds()
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            for(unsigned int j = 0; j < meshes[i].textures.size(); j++)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+                Texture &texture = meshes[i].textures[j];
+                texture.id = textures_loaded[textureSlots[texture.path]].id;
             }
         }
-        return textures;
+        pendingTextures.clear();
+        uploaded = true;
+        printOptimizationTotals();
+    }
+
+    void printOptimizationTotals() const
+    {
+        const MeshOptimizationStats &totals = optimizationTotals;
+        if(totals.triangles == 0)
+            return;
+        cout << "MESH::OPTIMIZE:: " << sourcePath << ": " << meshes.size() << " meshes, " << totals.triangles << " triangles, vertices "
+             << totals.verticesBefore << " -> " << totals.verticesAfter << ", ACMR " << totals.acmrBefore / totals.triangles
+             << " -> " << totals.acmrAfter / totals.triangles << endl;
     }
 };
 
@@ -208,36 +858,62 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
+    return TextureFromImage(DecodeImageFile(filename), gamma);
+}
+
+// creates the GL texture for pixels decoded by DecodeImageFile / the TextureDecodePool. must run on the GL thread.
+unsigned int TextureFromImage(const DecodedImage &image, bool gamma)
+{
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    if (image.compressedFormat)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
+        // block-compressed, with the mip chain already built by texture_compress.h
+        LoadTimer timer(image.path, LOAD_STAGE_GL_UPLOAD, image.byteSize());
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        const unsigned char *level = &image.compressed[0];
+        int width = image.width, height = image.height;
+        for (size_t i = 0; i < image.levelSizes.size(); i++)
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, image.compressedFormat, width, height, 0, (GLsizei)image.levelSizes[i], level);
+            level += image.levelSizes[i];
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.levelSizes.size() - 1);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    else if (image.data)
+    {
+        GLenum format = PlainTextureFormat(image.components);
 
-        stbi_image_free(data);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        {
+            LoadTimer timer(image.path, LOAD_STAGE_GL_UPLOAD, image.byteSize());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+        if (format == GL_RG)
+            SetGreyAlphaSwizzle(GL_TEXTURE_2D);
+        {
+            LoadTimer timer(image.path, LOAD_STAGE_MIP_GENERATION, image.byteSize() / 3);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        std::cout << "Texture failed to load at path: " << image.path << std::endl;
     }
 
     return textureID;
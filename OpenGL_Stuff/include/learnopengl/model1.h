@@ -14,20 +14,24 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/load_profiler.h>
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_pool.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <future>
 #include <vector>
 #include <cstring>
 
 using namespace std;
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
+unsigned int TextureFromImage(const DecodedImage& image, bool gamma = false);
 
 struct BoneInfo
 {
@@ -67,6 +71,14 @@ public:
     int& GetBoneCount() { return m_BoneCounter; }
 
 private:
+    // decodes queued on the TextureDecodePool, uploaded by finishTextureLoads()
+    struct PendingTexture
+    {
+        size_t slot; // index into textures_loaded
+        future<DecodedImage> image;
+    };
+    vector<PendingTexture> pendingTextures;
+
     void SetVertexBoneDataToDefault(Vertex& vertex)
     {
         for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
@@ -137,6 +149,7 @@ private:
 
     void ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, aiMesh* mesh, const aiScene* scene)
     {
+        LoadTimer timer(directory, LOAD_STAGE_BONE_EXTRACTION, 0, mesh->mNumBones);
         for (unsigned int boneIndex = 0; boneIndex < mesh->mNumBones; ++boneIndex)
         {
             int boneID = -1;
@@ -283,6 +296,7 @@ private:
 
 
         processNode(scene->mRootNode, scene);
+        finishTextureLoads();
     }
 
     void processNode(aiNode* node, const aiScene* scene)
@@ -461,10 +475,17 @@ private:
 
             if (!skip)
             {
+                // decode en paralelo; el id GL se asigna en finishTextureLoads()
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = 0;
                 texture.type = typeName;
                 texture.path = str.C_Str();
+
+                PendingTexture pending;
+                pending.slot = textures_loaded.size();
+                pending.image = TextureDecodePool::Instance().Submit(this->directory + '/' + texture.path);
+                pendingTextures.push_back(std::move(pending));
+
                 textures.push_back(texture);
                 textures_loaded.push_back(texture);
             }
@@ -472,6 +493,32 @@ private:
 
         return textures;
     }
+
+    // espera los decodes y sube las texturas en este hilo (GL), en el orden en que se pidieron
+    void finishTextureLoads()
+    {
+        if (pendingTextures.empty())
+            return;
+
+        map<string, unsigned int> ids;
+        for (unsigned int i = 0; i < pendingTextures.size(); i++)
+        {
+            Texture& texture = textures_loaded[pendingTextures[i].slot];
+            texture.id = TextureFromImage(pendingTextures[i].image.get());
+            ids[texture.path] = texture.id;
+        }
+        pendingTextures.clear();
+
+        for (auto& mesh : meshes)
+        {
+            for (auto& texture : mesh.textures)
+            {
+                auto it = ids.find(texture.path);
+                if (texture.id == 0 && it != ids.end())
+                    texture.id = it->second;
+            }
+        }
+    }
 };
 
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
@@ -489,14 +536,18 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
 
 
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
+    return TextureFromImage(DecodeImageFile(filename), gamma);
+}
 
+unsigned int TextureFromImage(const DecodedImage& image, bool gamma)
+{
+    const string& filename = image.path;
 
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
 
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    int width = image.width, height = image.height, nrComponents = image.components;
+    const unsigned char* data = image.data;
     if (data)
     {
         GLenum format = GL_RGB;
@@ -508,7 +559,6 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
         {
             std::cout << "Unsupported nrComponents = " << nrComponents
                 << " for texture: " << filename << std::endl;
-            stbi_image_free(data);
             return 0;
         }
 
@@ -524,13 +574,10 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
     }
     else
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        std::cout << "Texture failed to load at path: " << filename << std::endl;
 
 
 
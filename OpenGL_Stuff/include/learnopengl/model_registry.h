@@ -0,0 +1,155 @@
+#ifndef MODEL_REGISTRY_H
+#define MODEL_REGISTRY_H
+
+#include <learnopengl/model.h>
+#include <learnopengl/texture_cache.h>
+
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// shared reference to a Model owned by the ModelRegistry
+typedef std::shared_ptr<Model> ModelHandle;
+
+// Process-wide table of loaded models, keyed by the normalized path of their file.
+// Every user of a file gets a handle to the same Model, so its geometry and textures are on the
+// GPU once no matter how many places draw it; asking again for a loaded file costs a lookup.
+// The registry keeps its own reference, so a model stays resident after its users drop their
+// handles until Collect() or clear(). All of it runs on the GL thread.
+class ModelRegistry
+{
+public:
+    // resident memory of one registered model
+    struct Entry {
+        std::string path;
+        long users = 0;            // handles held outside the registry
+        ModelMemoryUsage memory;
+    };
+
+    static ModelRegistry &Instance()
+    {
+        static ModelRegistry registry;
+        return registry;
+    }
+
+    static std::string Key(const std::string &path)
+    {
+        return TextureCache::NormalizePath(path);
+    }
+
+    // the model of 'path', loaded and uploaded on the first request. 'options' only apply to that
+    // first load; later requests share whatever was loaded.
+    ModelHandle Load(const std::string &path, ModelLoadOptions options = ModelLoadOptions())
+    {
+        ModelHandle found = Find(path);
+        if (found)
+            return found;
+        options.deferUpload = false;
+        return Register(path, new Model(path, options));
+    }
+
+    // handle of a registered model, empty if 'path' isn't loaded
+    ModelHandle Find(const std::string &path) const
+    {
+        std::map<std::string, ModelHandle>::const_iterator it = models.find(Key(path));
+        return it != models.end() ? it->second : ModelHandle();
+    }
+
+    // takes ownership of a model loaded elsewhere (e.g. by the AssetLoader). if 'path' is already
+    // registered the new model is deleted and the existing one returned.
+    ModelHandle Register(const std::string &path, Model *model)
+    {
+        std::string key = Key(path);
+        std::map<std::string, ModelHandle>::iterator it = models.find(key);
+        if (it != models.end())
+        {
+            delete model;
+            return it->second;
+        }
+        ModelHandle handle(model);
+        models[key] = handle;
+        return handle;
+    }
+
+    // destroys the model of 'path' if nobody else holds a handle to it. returns false if it is
+    // still in use (it stays registered) or isn't registered.
+    bool Evict(const std::string &path)
+    {
+        std::map<std::string, ModelHandle>::iterator it = models.find(Key(path));
+        if (it == models.end() || it->second.use_count() > 1)
+            return false;
+        models.erase(it);
+        return true;
+    }
+
+    // destroys the models nobody holds a handle to. returns how many were freed.
+    unsigned int Collect()
+    {
+        unsigned int freed = 0;
+        for (std::map<std::string, ModelHandle>::iterator it = models.begin(); it != models.end();)
+        {
+            if (it->second.use_count() == 1)
+            {
+                it = models.erase(it);
+                freed++;
+            }
+            else
+                ++it;
+        }
+        return freed;
+    }
+
+    // drops the registry's references; models still held elsewhere die with their last handle.
+    // call before the GL context goes away.
+    void clear()
+    {
+        models.clear();
+    }
+
+    size_t Count() const { return models.size(); }
+
+    std::vector<Entry> MemoryReport() const
+    {
+        std::vector<Entry> report;
+        for (std::map<std::string, ModelHandle>::const_iterator it = models.begin(); it != models.end(); ++it)
+        {
+            Entry entry;
+            entry.path = it->first;
+            entry.users = it->second.use_count() - 1;
+            entry.memory = it->second->MemoryUsage();
+            report.push_back(entry);
+        }
+        return report;
+    }
+
+    // one line per model plus the totals; shared textures are listed under every model using them
+    // but counted once in the total
+    void PrintMemoryReport(std::ostream &out) const
+    {
+        std::vector<Entry> report = MemoryReport();
+        size_t geometry = 0;
+        out << "MODEL_REGISTRY:: " << report.size() << " models" << std::endl;
+        for (size_t i = 0; i < report.size(); i++)
+        {
+            const Entry &entry = report[i];
+            geometry += entry.memory.geometryBytes;
+            out << "  " << entry.path << ": users " << entry.users
+                << ", geometry " << std::fixed << std::setprecision(2) << entry.memory.geometryBytes / (1024.0 * 1024.0) << " MB"
+                << ", textures " << entry.memory.textures << " / " << entry.memory.textureBytes / (1024.0 * 1024.0) << " MB"
+                << " (" << entry.memory.sharedTextureBytes / (1024.0 * 1024.0) << " MB shared)" << std::endl;
+        }
+        TextureCache::Stats textures = TextureCache::Instance().GetStats();
+        out << "  total: geometry " << geometry / (1024.0 * 1024.0) << " MB, textures " << textures.textures << " / "
+            << textures.bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+        out.unsetf(std::ios::fixed);
+    }
+
+private:
+    std::map<std::string, ModelHandle> models;
+
+    ModelRegistry() {}
+};
+#endif
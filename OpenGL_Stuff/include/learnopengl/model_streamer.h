@@ -0,0 +1,213 @@
+#ifndef MODEL_STREAMER_H
+#define MODEL_STREAMER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/asset_loader.h>
+#include <learnopengl/model_registry.h>
+
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Loads models only while the viewer is close to where they are needed and frees them afterwards.
+// Each streamed model has trigger points, each with a condition that says whether its event still
+// needs the model. When the viewer gets within 'prefetchRadius' of an active trigger the model is
+// imported in the background (an AssetLoader of its own) and uploaded from Update() under the
+// frame's byte budget; when it's resident it appears in its ModelHandle. Models whose triggers
+// are all inactive are evicted, largest first, while the streamed models use more than
+// 'memoryBudget' bytes (0 evicts them as soon as they are done). An evicted model that someone
+// else still holds a handle to stays counted against the budget until that handle is dropped and
+// the model is really freed. A model that becomes needed again is simply streamed in again (or
+// taken back, if it was never freed). Everything runs on the GL thread.
+class ModelStreamer
+{
+public:
+    ModelStreamer(float prefetchRadius, size_t memoryBudget, const ModelLoadOptions &options = ModelLoadOptions())
+        : radius(prefetchRadius), budget(memoryBudget), loadOptions(options)
+    {
+    }
+
+    ModelStreamer(const ModelStreamer &) = delete;
+    ModelStreamer &operator=(const ModelStreamer &) = delete;
+
+    // streams 'path' into '*target', which stays empty while the model isn't resident. returns the id
+    // to attach triggers to.
+    int AddModel(const std::string &path, ModelHandle *target)
+    {
+        std::unique_ptr<Asset> asset(new Asset());
+        asset->path = path;
+        asset->target = target;
+        assets.push_back(std::move(asset));
+        return (int)assets.size() - 1;
+    }
+
+    // the model 'asset' is needed around 'position' for as long as 'active' returns true
+    void AddTrigger(int asset, const glm::vec3 &position, std::function<bool()> active)
+    {
+        Trigger trigger;
+        trigger.position = position;
+        trigger.active = active;
+        assets[asset]->triggers.push_back(trigger);
+    }
+
+    // starts, advances and finishes loads around 'viewer' and evicts what isn't needed. once per frame.
+    void Update(const glm::vec3 &viewer, size_t uploadBudget)
+    {
+        for (size_t i = 0; i < assets.size(); i++)
+        {
+            Asset &asset = *assets[i];
+            if (asset.state == RELEASED)
+                collect(asset);
+            if ((asset.state == UNLOADED || asset.state == RELEASED) && asset.near(viewer, radius))
+                startLoad(asset);
+            if (asset.state == LOADING)
+            {
+                asset.loader->Update(uploadBudget);
+                if (asset.loader->Done())
+                {
+                    asset.loader.reset();
+                    becomeResident(asset);
+                }
+            }
+        }
+
+        for (;;)
+        {
+            size_t resident = ResidentBytes();
+            if (resident <= budget && budget > 0)
+                break;
+            Asset *victim = nullptr;
+            for (size_t i = 0; i < assets.size(); i++)
+            {
+                Asset &asset = *assets[i];
+                if (asset.state == RESIDENT && !asset.needed() && (!victim || asset.bytes > victim->bytes))
+                    victim = &asset;
+            }
+            if (!victim)
+                break;
+            evict(*victim);
+        }
+    }
+
+    // GPU bytes of the streamed models that are resident, including evicted ones not freed yet
+    size_t ResidentBytes() const
+    {
+        size_t bytes = 0;
+        for (size_t i = 0; i < assets.size(); i++)
+            if (assets[i]->state == RESIDENT || assets[i]->state == RELEASED)
+                bytes += assets[i]->bytes;
+        return bytes;
+    }
+
+    bool IsResident(int asset) const { return assets[asset]->state == RESIDENT; }
+    bool IsLoading(int asset) const { return assets[asset]->state == LOADING; }
+
+    // frees every streamed model and waits for loads in flight. call before the GL context goes away.
+    void clear()
+    {
+        for (size_t i = 0; i < assets.size(); i++)
+        {
+            Asset &asset = *assets[i];
+            asset.loader.reset();
+            if (asset.state == RESIDENT)
+                evict(asset);
+            if (asset.state == RELEASED)
+                collect(asset);
+            asset.state = UNLOADED;
+            asset.bytes = 0;
+        }
+    }
+
+private:
+    // RELEASED: evicted, but another handle keeps the model alive
+    enum State { UNLOADED, LOADING, RESIDENT, RELEASED };
+
+    struct Trigger {
+        glm::vec3 position;
+        std::function<bool()> active;
+    };
+
+    struct Asset {
+        std::string path;
+        ModelHandle *target = nullptr;
+        std::vector<Trigger> triggers;
+        State state = UNLOADED;
+        std::unique_ptr<AssetLoader> loader;
+        size_t bytes = 0;   // GPU memory measured when it became resident
+
+        bool needed() const
+        {
+            for (size_t i = 0; i < triggers.size(); i++)
+                if (triggers[i].active())
+                    return true;
+            return false;
+        }
+
+        bool near(const glm::vec3 &viewer, float radius) const
+        {
+            for (size_t i = 0; i < triggers.size(); i++)
+                if (glm::distance(viewer, triggers[i].position) <= radius && triggers[i].active())
+                    return true;
+            return false;
+        }
+    };
+
+    float radius;
+    size_t budget;
+    ModelLoadOptions loadOptions;
+    std::vector<std::unique_ptr<Asset>> assets;
+
+    void startLoad(Asset &asset)
+    {
+        asset.loader.reset(new AssetLoader());
+        asset.loader->QueueModel(asset.path, asset.target, loadOptions);
+        if (*asset.target)
+        {
+            // still registered (someone else kept a handle), nothing to load
+            asset.loader.reset();
+            becomeResident(asset);
+            return;
+        }
+        std::cout << "STREAMING:: loading " << asset.path << std::endl;
+        asset.loader->Start();
+        asset.state = LOADING;
+    }
+
+    void becomeResident(Asset &asset)
+    {
+        asset.state = RESIDENT;
+        if (*asset.target)
+        {
+            ModelMemoryUsage memory = (*asset.target)->MemoryUsage();
+            asset.bytes = memory.geometryBytes + memory.textureBytes;
+        }
+    }
+
+    void evict(Asset &asset)
+    {
+        asset.target->reset();
+        asset.state = RELEASED;
+        if (!collect(asset))
+            std::cout << "STREAMING:: released (still in use) " << asset.path << std::endl;
+    }
+
+    // frees a released model once the registry holds the only other reference. returns whether it
+    // is gone.
+    bool collect(Asset &asset)
+    {
+        ModelRegistry &registry = ModelRegistry::Instance();
+        if (registry.Find(asset.path))
+        {
+            if (!registry.Evict(asset.path))
+                return false;
+            std::cout << "STREAMING:: evicted " << asset.path << std::endl;
+        }
+        asset.state = UNLOADED;
+        asset.bytes = 0;
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,347 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/instance_buffer.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+enum RenderPass {
+    RENDER_PASS_OPAQUE,        // front to back, so early-Z rejects what's hidden
+    RENDER_PASS_TRANSPARENT    // back to front, after the opaque pass
+};
+
+// Sort key of a draw packet, most significant bits first:
+//
+//     opaque:       pass (2) | shader (8) | material (20) | vertex array (12) | depth (22)
+//     transparent:  pass (2) | inverted depth (22) | shader (8) | material (20) | vertex array (12)
+//
+// so opaque draws are grouped by state and go front to back within a state, and transparent ones
+// are ordered by depth alone. the ids are truncated to their field: two shaders or materials that
+// share bits only sort less well, the queue still binds whatever each packet needs.
+const unsigned int RENDER_KEY_PASS_SHIFT = 62;
+const unsigned int RENDER_KEY_SHADER_BITS = 8;
+const unsigned int RENDER_KEY_MATERIAL_BITS = 20;
+const unsigned int RENDER_KEY_VAO_BITS = 12;
+const unsigned int RENDER_KEY_DEPTH_BITS = 22;
+
+// one frame of the queue: what frustum culling kept and dropped while submitting, and the state
+// changes of the Flush() (what was bound and what the sort made redundant)
+struct RenderQueueStats {
+    size_t modelsVisible = 0, modelsCulled = 0;   // model placements (each instanced copy counts)
+    size_t meshesVisible = 0, meshesCulled = 0;   // meshes of the visible models
+    size_t packets = 0;
+    size_t instancedPackets = 0, instances = 0;   // instanced draws and the copies they drew
+    size_t shaderBinds = 0, shaderBindsSkipped = 0;
+    size_t vaoBinds = 0, vaoBindsSkipped = 0;
+    size_t textureBinds = 0, textureBindsSkipped = 0;
+    size_t matrixUploads = 0, matrixUploadsSkipped = 0;
+
+    size_t Eliminated() const { return shaderBindsSkipped + vaoBindsSkipped + textureBindsSkipped + matrixUploadsSkipped; }
+};
+
+// Collects the meshes of the models drawn in a frame as packets with a 64-bit sort key, then sorts
+// them and draws them in one go, binding the shader, textures, vertex array and model matrix only
+// when they change. Submit() is cheap and touches no GL state; Flush() draws and clears the queue.
+// With a frustum set, Submit() first drops whatever the import-time bounds put out of view.
+// The shaders must declare the uniforms Mesh::Draw sets plus 'model', or read the instance matrix
+// attributes for SubmitInstanced(). GL thread only.
+class RenderQueue
+{
+public:
+    // distance mapped to the full depth range of the key; anything further sorts as this far
+    float maxDepth = 100.0f;
+
+    // from now on, skips the models and meshes whose bounds are outside 'frustum' (built from the
+    // projection * view the shaders use); set it again every frame the camera moves
+    void SetFrustum(const Frustum &frustum)
+    {
+        this->frustum = frustum;
+        culling = true;
+    }
+
+    // submits everything again
+    void DisableCulling() { culling = false; }
+
+    // queues every uploaded, visible mesh of 'model' under 'modelMatrix', each with the level of
+    // detail Model::Draw would pick for it as seen from 'viewPosition'
+    void Submit(Model &model, Shader &shader, const glm::mat4 &modelMatrix, const glm::vec3 &viewPosition,
+                RenderPass pass = RENDER_PASS_OPAQUE)
+    {
+        if(culling && !frustum.IntersectsBounds(modelMatrix, model.boundsMin, model.boundsMax, model.boundsCentre, model.boundsRadius))
+        {
+            submitted.modelsCulled++;
+            return;
+        }
+        submitted.modelsVisible++;
+        unsigned int matrix = (unsigned int)matrices.size();
+        matrices.push_back(modelMatrix);
+        for(size_t i = 0; i < model.meshes.size(); i++)
+        {
+            Mesh &mesh = model.meshes[i];
+            if(!mesh.IsUploaded())
+                continue;
+            if(culling && !frustum.IntersectsBounds(modelMatrix, mesh.boundsMin, mesh.boundsMax, mesh.boundsCentre, mesh.boundsRadius))
+            {
+                submitted.meshesCulled++;
+                continue;
+            }
+            submitted.meshesVisible++;
+            Packet packet;
+            packet.mesh = &mesh;
+            packet.shader = &shader;
+            packet.matrix = matrix;
+            packet.instances = nullptr;
+            packet.lod = Model::SelectLod(mesh, modelMatrix, viewPosition);
+            glm::vec3 centre = glm::vec3(modelMatrix * glm::vec4(mesh.boundsCentre, 1.0f));
+            packet.key = makeKey(pass, shader.ID, materialId(mesh), mesh.VertexArray(), glm::length(centre - viewPosition));
+            packets.push_back(packet);
+        }
+    }
+
+    // queues every uploaded mesh of 'model' once for all the copies in 'instances', drawn with a
+    // single instanced call per mesh. 'shader' reads the model matrix from the instance attributes;
+    // the buffer must stay alive and unchanged until Flush(). the buffer is drawn whole, so culling
+    // only drops a mesh when none of the visible copies can see it.
+    void SubmitInstanced(Model &model, Shader &shader, const InstanceBuffer &instances, const glm::vec3 &viewPosition,
+                         RenderPass pass = RENDER_PASS_OPAQUE)
+    {
+        if(instances.Count() == 0)
+            return;
+        const std::vector<glm::mat4> &copies = instances.Matrices();
+        visibleCopies.clear();
+        for(size_t c = 0; c < copies.size(); c++)
+        {
+            if(culling && !frustum.IntersectsBounds(copies[c], model.boundsMin, model.boundsMax, model.boundsCentre, model.boundsRadius))
+                submitted.modelsCulled++;
+            else
+            {
+                submitted.modelsVisible++;
+                visibleCopies.push_back((unsigned int)c);
+            }
+        }
+        if(visibleCopies.empty())
+            return;
+        for(size_t i = 0; i < model.meshes.size(); i++)
+        {
+            Mesh &mesh = model.meshes[i];
+            if(!mesh.IsUploaded())
+                continue;
+            if(culling && !anyCopySees(mesh, copies))
+            {
+                submitted.meshesCulled++;
+                continue;
+            }
+            submitted.meshesVisible++;
+            Packet packet;
+            packet.mesh = &mesh;
+            packet.shader = &shader;
+            packet.matrix = 0;
+            packet.instances = &instances;
+            packet.lod = Model::SelectInstancedLod(mesh, copies, viewPosition);
+            // sorted by the nearest visible copy
+            glm::vec4 centre = glm::vec4(mesh.boundsCentre, 1.0f);
+            float distance = maxDepth;
+            for(size_t c = 0; c < visibleCopies.size(); c++)
+                distance = std::min(distance, glm::length(glm::vec3(copies[visibleCopies[c]] * centre) - viewPosition));
+            packet.key = makeKey(pass, shader.ID, materialId(mesh), mesh.VertexArray(), distance);
+            packets.push_back(packet);
+        }
+    }
+
+    // sorts and draws everything queued since the last Flush()
+    void Flush()
+    {
+        stats = submitted;
+        submitted = RenderQueueStats();
+        stats.packets = packets.size();
+        order.resize(packets.size());
+        for(size_t i = 0; i < packets.size(); i++)
+            order[i] = SortEntry{ packets[i].key, (unsigned int)i };
+        std::sort(order.begin(), order.end(), [](const SortEntry &a, const SortEntry &b) {
+            return a.key != b.key ? a.key < b.key : a.index < b.index;
+        });
+
+        Shader *shader = nullptr;
+        unsigned int vao = 0;
+        const InstanceBuffer *attached = nullptr;   // instances attached to 'vao'
+        unsigned int matrix = (unsigned int)-1;
+        TextureBindings bindings;
+        for(size_t i = 0; i < order.size(); i++)
+        {
+            Packet &packet = packets[order[i].index];
+            if(packet.shader != shader)
+            {
+                shader = packet.shader;
+                shader->use();
+                stats.shaderBinds++;
+                matrix = (unsigned int)-1;   // the matrix is program state
+            }
+            else
+                stats.shaderBindsSkipped++;
+
+            // instanced packets read their matrices from the instance attributes
+            if(!packet.instances)
+            {
+                if(packet.matrix != matrix)
+                {
+                    matrix = packet.matrix;
+                    shader->set(shader->MeshBindings().model, matrices[matrix]);
+                    stats.matrixUploads++;
+                }
+                else
+                    stats.matrixUploadsSkipped++;
+            }
+
+            packet.mesh->BindTextures(*shader, &bindings);
+            packet.mesh->BindQuantization(*shader);
+            if(packet.mesh->VertexArray() != vao || packet.instances != attached)
+            {
+                if(attached)
+                    InstanceBuffer::Detach();
+                attached = nullptr;
+                if(packet.mesh->VertexArray() != vao)
+                {
+                    vao = packet.mesh->VertexArray();
+                    glBindVertexArray(vao);
+                    stats.vaoBinds++;
+                }
+                else
+                    stats.vaoBindsSkipped++;
+                if(packet.instances)
+                {
+                    packet.instances->Attach();
+                    attached = packet.instances;
+                }
+            }
+            else
+                stats.vaoBindsSkipped++;
+
+            if(packet.instances)
+            {
+                packet.mesh->DrawElementsInstanced(packet.lod, packet.instances->Count());
+                stats.instancedPackets++;
+                stats.instances += packet.instances->Count();
+            }
+            else
+                packet.mesh->DrawElements(packet.lod);
+        }
+        if(attached)
+            InstanceBuffer::Detach();
+        stats.textureBinds = bindings.binds;
+        stats.textureBindsSkipped = bindings.skipped;
+        if(vao)
+            glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+
+        packets.clear();
+        matrices.clear();
+    }
+
+    // counters of the last Flush() and the submits before it
+    const RenderQueueStats &Stats() const { return stats; }
+
+    void PrintStats(std::ostream &out) const
+    {
+        out << "RENDER_QUEUE:: " << stats.modelsVisible << " models visible, " << stats.modelsCulled << " culled; "
+            << stats.meshesVisible << " meshes visible, " << stats.meshesCulled << " culled" << std::endl;
+        out << "RENDER_QUEUE:: " << stats.packets << " draws (" << stats.instancedPackets << " instanced, "
+            << stats.instances << " copies), "
+            << stats.shaderBinds << " shader / " << stats.vaoBinds << " VAO / " << stats.textureBinds << " texture binds, "
+            << stats.matrixUploads << " matrix uploads; skipped " << stats.shaderBindsSkipped << " / "
+            << stats.vaoBindsSkipped << " / " << stats.textureBindsSkipped << " / " << stats.matrixUploadsSkipped
+            << " (" << stats.Eliminated() << " redundant)" << std::endl;
+    }
+
+private:
+    struct Packet {
+        uint64_t key;
+        Mesh *mesh;
+        Shader *shader;
+        unsigned int matrix;                // index into 'matrices'
+        const InstanceBuffer *instances;    // set for instanced packets, which have no matrix
+        unsigned int lod;
+    };
+    struct SortEntry {
+        uint64_t key;
+        unsigned int index;
+    };
+
+    std::vector<Packet> packets;
+    std::vector<glm::mat4> matrices;
+    std::vector<SortEntry> order;
+    // texture set signature -> dense material id, kept across frames so ids stay stable
+    std::unordered_map<uint64_t, uint32_t> materials;
+    Frustum frustum;
+    bool culling = false;
+    std::vector<unsigned int> visibleCopies;   // scratch for SubmitInstanced()
+    RenderQueueStats submitted;                 // culling counters of the frame being queued
+    RenderQueueStats stats;
+
+    // whether 'mesh' is inside the frustum for any of the visible copies
+    bool anyCopySees(const Mesh &mesh, const std::vector<glm::mat4> &copies) const
+    {
+        for(size_t c = 0; c < visibleCopies.size(); c++)
+            if(frustum.IntersectsBounds(copies[visibleCopies[c]], mesh.boundsMin, mesh.boundsMax, mesh.boundsCentre, mesh.boundsRadius))
+                return true;
+        return false;
+    }
+
+    static uint64_t field(uint64_t value, unsigned int bits)
+    {
+        return value & ((1ULL << bits) - 1);
+    }
+
+    uint64_t makeKey(RenderPass pass, unsigned int shader, uint32_t material, unsigned int vao, float distance) const
+    {
+        float depth = glm::clamp(distance / maxDepth, 0.0f, 1.0f);
+        uint64_t quantized = (uint64_t)(depth * (float)((1ULL << RENDER_KEY_DEPTH_BITS) - 1));
+        uint64_t key = (uint64_t)pass << RENDER_KEY_PASS_SHIFT;
+        if(pass == RENDER_PASS_OPAQUE)
+        {
+            key |= field(shader, RENDER_KEY_SHADER_BITS) << (RENDER_KEY_MATERIAL_BITS + RENDER_KEY_VAO_BITS + RENDER_KEY_DEPTH_BITS);
+            key |= field(material, RENDER_KEY_MATERIAL_BITS) << (RENDER_KEY_VAO_BITS + RENDER_KEY_DEPTH_BITS);
+            key |= field(vao, RENDER_KEY_VAO_BITS) << RENDER_KEY_DEPTH_BITS;
+            key |= quantized;
+        }
+        else
+        {
+            uint64_t inverted = ((1ULL << RENDER_KEY_DEPTH_BITS) - 1) - quantized;
+            key |= inverted << (RENDER_KEY_SHADER_BITS + RENDER_KEY_MATERIAL_BITS + RENDER_KEY_VAO_BITS);
+            key |= field(shader, RENDER_KEY_SHADER_BITS) << (RENDER_KEY_MATERIAL_BITS + RENDER_KEY_VAO_BITS);
+            key |= field(material, RENDER_KEY_MATERIAL_BITS) << RENDER_KEY_VAO_BITS;
+            key |= field(vao, RENDER_KEY_VAO_BITS);
+        }
+        return key;
+    }
+
+    // id of the textures the mesh binds (an array-packed texture counts as its array), so meshes
+    // that bind the same ones sort next to each other
+    uint32_t materialId(const Mesh &mesh)
+    {
+        uint64_t signature = 14695981039346656037ULL;
+        for(size_t i = 0; i < mesh.textures.size(); i++)
+        {
+            const Texture &texture = mesh.textures[i];
+            uint64_t bound = texture.arrayLayer.valid() ? (1ULL << 32) | texture.arrayLayer.array : texture.id;
+            signature = (signature ^ (bound + i)) * 1099511628211ULL;
+        }
+        std::unordered_map<uint64_t, uint32_t>::iterator it = materials.find(signature);
+        if(it != materials.end())
+            return it->second;
+        uint32_t id = (uint32_t)materials.size();
+        materials[signature] = id;
+        return id;
+    }
+};
+#endif
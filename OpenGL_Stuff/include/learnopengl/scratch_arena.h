@@ -0,0 +1,163 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+// Monotonic allocator for import-time temporaries (welding tables, optimizer state, simplifier
+// queues...). Allocation bumps a pointer through large blocks and freeing does nothing; a
+// ScratchScope rewinds the arena to where it was when the scope opened, so the next mesh reuses
+// the same memory. Blocks are only returned when the arena is destroyed: every thread has its own
+// arena (ThreadScratchArena), freed with the thread.
+class ScratchArena
+{
+public:
+    // position to rewind to
+    struct Mark {
+        size_t block = 0;
+        size_t used = 0;
+    };
+
+    explicit ScratchArena(size_t blockBytes = 1024 * 1024) : blockSize(blockBytes) {}
+
+    ~ScratchArena()
+    {
+        for (size_t i = 0; i < blocks.size(); i++)
+            ::operator delete(blocks[i].data);
+    }
+
+    ScratchArena(const ScratchArena &) = delete;
+    ScratchArena &operator=(const ScratchArena &) = delete;
+
+    void *Allocate(size_t bytes, size_t alignment)
+    {
+        while (current < blocks.size())
+        {
+            Block &block = blocks[current];
+            size_t start = (block.used + alignment - 1) & ~(alignment - 1);
+            if (start + bytes <= block.size)
+            {
+                block.used = start + bytes;
+                peak = std::max(peak, usedBytes());
+                return block.data + start;
+            }
+            // blocks past the current one only hold rewound data
+            if (++current < blocks.size())
+                blocks[current].used = 0;
+        }
+        // operator new returns memory aligned for any fundamental type, so offsets keep the alignment
+        Block block;
+        block.size = std::max(blockSize, bytes + alignment);
+        block.data = (char *)::operator new(block.size);
+        block.used = bytes;
+        blocks.push_back(block);
+        current = blocks.size() - 1;
+        peak = std::max(peak, usedBytes());
+        return block.data;
+    }
+
+    Mark GetMark() const
+    {
+        Mark mark;
+        mark.block = current;
+        mark.used = current < blocks.size() ? blocks[current].used : 0;
+        return mark;
+    }
+
+    // frees everything allocated after 'mark'
+    void Rewind(const Mark &mark)
+    {
+        current = mark.block;
+        if (current < blocks.size())
+            blocks[current].used = mark.used;
+    }
+
+    // bytes handed out and not rewound
+    size_t usedBytes() const
+    {
+        size_t used = 0;
+        for (size_t i = 0; i <= current && i < blocks.size(); i++)
+            used += blocks[i].used;
+        return used;
+    }
+
+    size_t PeakBytes() const { return peak; }
+
+    size_t ReservedBytes() const
+    {
+        size_t reserved = 0;
+        for (size_t i = 0; i < blocks.size(); i++)
+            reserved += blocks[i].size;
+        return reserved;
+    }
+
+private:
+    struct Block {
+        char *data = nullptr;
+        size_t size = 0;
+        size_t used = 0;
+    };
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t blockSize;
+    size_t peak = 0;
+};
+
+// the calling thread's arena
+inline ScratchArena &ThreadScratchArena()
+{
+    static thread_local ScratchArena arena;
+    return arena;
+}
+
+// standard allocator over a ScratchArena, for containers that die before their ScratchScope.
+// deallocate() is a no-op: the memory comes back when the scope rewinds.
+template <class T>
+struct ScratchAllocator {
+    typedef T value_type;
+
+    ScratchArena *arena;
+
+    explicit ScratchAllocator(ScratchArena &scratch) : arena(&scratch) {}
+    template <class U>
+    ScratchAllocator(const ScratchAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t count)
+    {
+        return (T *)arena->Allocate(count * sizeof(T), alignof(T));
+    }
+
+    void deallocate(T *, size_t) {}
+};
+
+template <class T, class U>
+bool operator==(const ScratchAllocator<T> &a, const ScratchAllocator<U> &b) { return a.arena == b.arena; }
+template <class T, class U>
+bool operator!=(const ScratchAllocator<T> &a, const ScratchAllocator<U> &b) { return a.arena != b.arena; }
+
+template <class T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;
+
+// Rewinds the thread's arena when it goes out of scope. Containers built with it (it converts to
+// any ScratchAllocator) must not outlive it, and a container of an outer scope must not grow while
+// an inner scope is open: the inner rewind would hand its new memory out again.
+class ScratchScope
+{
+public:
+    ScratchScope() : arena(ThreadScratchArena()), mark(arena.GetMark()) {}
+    ~ScratchScope() { arena.Rewind(mark); }
+
+    ScratchScope(const ScratchScope &) = delete;
+    ScratchScope &operator=(const ScratchScope &) = delete;
+
+    template <class T>
+    operator ScratchAllocator<T>() const { return ScratchAllocator<T>(arena); }
+
+private:
+    ScratchArena &arena;
+    ScratchArena::Mark mark;
+};
+#endif
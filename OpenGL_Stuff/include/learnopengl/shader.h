@@ -2,11 +2,69 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/load_profiler.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// a uniform location looked up once (Shader::GetUniform) and passed to Shader::set every frame;
+// the type picks the glUniform call. an invalid handle (location -1) is ignored by GL.
+template <typename T>
+struct Uniform
+{
+    GLint location = -1;
+    bool valid() const { return location >= 0; }
+};
+
+// the material samplers Mesh::BindTextures numbers: texture_diffuse1, texture_diffuse2, ...
+enum MaterialTextureKind {
+    MATERIAL_DIFFUSE,
+    MATERIAL_SPECULAR,
+    MATERIAL_NORMAL,
+    MATERIAL_HEIGHT,
+    MATERIAL_TEXTURE_KINDS
+};
+const unsigned int MATERIAL_SAMPLERS_PER_KIND = 4;
+
+// sampler name prefix of a kind, also its Texture::type
+inline const char *MaterialSamplerName(int kind)
+{
+    static const char *names[MATERIAL_TEXTURE_KINDS] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+    return names[kind];
+}
+
+// the kind of a Texture::type, or -1 for types that aren't numbered
+inline int GetMaterialTextureKind(const std::string &type)
+{
+    if(type == "texture_diffuse")
+        return MATERIAL_DIFFUSE;
+    if(type == "texture_specular")
+        return MATERIAL_SPECULAR;
+    if(type == "texture_normal")
+        return MATERIAL_NORMAL;
+    if(type == "texture_height")
+        return MATERIAL_HEIGHT;
+    return -1;
+}
+
+// the uniforms every mesh draw sets (the model matrix when drawn by a RenderQueue), resolved when
+// the program links
+struct MeshUniforms
+{
+    GLint samplers[MATERIAL_TEXTURE_KINDS][MATERIAL_SAMPLERS_PER_KIND];
+    Uniform<int> diffuseArray, specularArray;
+    Uniform<int> diffuseLayer, specularLayer;
+    Uniform<bool> quantizedPositions;
+    Uniform<glm::vec3> positionScale, positionOffset;
+    Uniform<glm::mat4> model;
+};
 
 class Shader
 {
@@ -16,49 +74,29 @@ public:
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
+        // 1. retrieve the vertex/fragment source code from filePath (or the mounted asset pack)
         std::string vertexCode;
         std::string fragmentCode;
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            LoadTimer readTimer(vertexPath, LOAD_STAGE_FILE_READ);
+            AssetFile vShaderFile(vertexPath);
+            AssetFile fShaderFile(fragmentPath);
+            AssetFile gShaderFile;
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
-            {
                 gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            if(!vShaderFile.isOpen() || !fShaderFile.isOpen() || (geometryPath != nullptr && !gShaderFile.isOpen()))
+                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            vertexCode = vShaderFile.text();
+            fragmentCode = fShaderFile.text();
+            geometryCode = gShaderFile.text();
+            readTimer.AddBytes(vertexCode.size() + fragmentCode.size() + geometryCode.size());
         }
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
+        // 2. compile shaders (timed up to the link, under the vertex shader's path)
+        LoadTimer compileTimer(vertexPath, LOAD_STAGE_SHADER_COMPILE, 0, geometryPath != nullptr ? 3 : 2);
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -93,7 +131,7 @@ public:
         glDeleteShader(fragment);
         if(geometryPath != nullptr)
             glDeleteShader(geometry);
-
+        reflectUniforms();
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -101,66 +139,208 @@ public:
     { 
         glUseProgram(ID); 
     }
-    // utility uniform functions
+    // vertex attribute locations the linked program really reads: bit n set for location n.
+    // a Model loaded with this mask (ModelLoadOptions::vertexAttributes) skips everything else.
+    // ------------------------------------------------------------------------
+    unsigned int ActiveAttributeMask() const
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+        std::string name(maxLength > 0 ? maxLength : 1, '\0');
+        unsigned int mask = 0;
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveAttrib(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+            // built-ins like gl_VertexID have no location
+            GLint location = glGetAttribLocation(ID, name.c_str());
+            if (location < 0)
+                continue;
+            // matrices and arrays take one location per column / element
+            int slots = size * (type == GL_FLOAT_MAT4 ? 4 : type == GL_FLOAT_MAT3 ? 3 : type == GL_FLOAT_MAT2 ? 2 : 1);
+            for (int slot = 0; slot < slots && location + slot < 32; slot++)
+                mask |= 1u << (location + slot);
+        }
+        return mask;
+    }
+    // location of an active uniform from the table built at link time, -1 if the program doesn't
+    // use it. array elements can be looked up as "name[i]" and struct members as "name[i].member".
+    // ------------------------------------------------------------------------
+    GLint Location(const std::string &name) const
+    {
+        std::unordered_map<std::string, GLint>::const_iterator it = locations.find(name);
+        return it != locations.end() ? it->second : -1;
+    }
+    // a handle for 'name' to keep and pass to set(); resolve it once, not per frame
+    // ------------------------------------------------------------------------
+    template <typename T>
+    Uniform<T> GetUniform(const std::string &name) const
+    {
+        Uniform<T> uniform;
+        uniform.location = Location(name);
+        return uniform;
+    }
+    // the locations Mesh::Draw uses, resolved at link time
+    // ------------------------------------------------------------------------
+    const MeshUniforms &MeshBindings() const
+    {
+        return mesh;
+    }
+    // location of material sampler number 'number' (1-based) of 'kind', e.g. texture_specular2
+    // ------------------------------------------------------------------------
+    GLint SamplerLocation(int kind, unsigned int number) const
+    {
+        if(number >= 1 && number <= MATERIAL_SAMPLERS_PER_KIND)
+            return mesh.samplers[kind][number - 1];
+        return Location(MaterialSamplerName(kind) + std::to_string(number));
+    }
+    // points a sampler at texture unit 'unit'. the value is remembered, so meshes that use the same
+    // units don't set it again; samplers set this way shouldn't also be set with setInt.
+    // ------------------------------------------------------------------------
+    void BindSampler(GLint location, int unit)
+    {
+        if(location < 0)
+            return;
+        if((size_t)location >= samplerUnits.size())
+            samplerUnits.resize(location + 1, -1);
+        if(samplerUnits[location] == unit)
+            return;
+        samplerUnits[location] = unit;
+        glUniform1i(location, unit);
+    }
+    // connects uniform block 'name' to a GL_UNIFORM_BUFFER binding point, if the program has it
+    // ------------------------------------------------------------------------
+    void BindUniformBlock(const char *name, unsigned int binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+    // typed handle setters, for the per-frame path
+    // ------------------------------------------------------------------------
+    void set(Uniform<bool> uniform, bool value) const { glUniform1i(uniform.location, (int)value); }
+    void set(Uniform<int> uniform, int value) const { glUniform1i(uniform.location, value); }
+    void set(Uniform<float> uniform, float value) const { glUniform1f(uniform.location, value); }
+    void set(Uniform<glm::vec2> uniform, const glm::vec2 &value) const { glUniform2fv(uniform.location, 1, &value[0]); }
+    void set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const { glUniform3fv(uniform.location, 1, &value[0]); }
+    void set(Uniform<glm::vec4> uniform, const glm::vec4 &value) const { glUniform4fv(uniform.location, 1, &value[0]); }
+    void set(Uniform<glm::mat3> uniform, const glm::mat3 &mat) const { glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
+    void set(Uniform<glm::mat4> uniform, const glm::mat4 &mat) const { glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]); }
+    // utility uniform functions (looked up in the location table)
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(Location(name), (int)value); 
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(Location(name), value); 
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(Location(name), value); 
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(Location(name), 1, &value[0]); 
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(Location(name), x, y); 
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(Location(name), 1, &value[0]); 
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(Location(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(Location(name), 1, &value[0]); 
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(Location(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(Location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(Location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(Location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    std::unordered_map<std::string, GLint> locations;
+    MeshUniforms mesh;
+    std::vector<int> samplerUnits;   // value last set per sampler location by BindSampler, -1 unknown
+
+    // fills the location table from the program's active uniforms. uniforms in blocks have no
+    // location and are skipped.
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::string name(maxLength > 0 ? maxLength : 1, '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+            std::string uniform(name.c_str(), length);
+            GLint location = glGetUniformLocation(ID, uniform.c_str());
+            if (location < 0)
+                continue;
+            locations[uniform] = location;
+            // arrays are reported as "name[0]": the bare name and every element can be set too
+            if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = uniform.substr(0, uniform.size() - 3);
+                locations[base] = location;
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    locations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+                }
+            }
+        }
+
+        for (int kind = 0; kind < MATERIAL_TEXTURE_KINDS; kind++)
+        {
+            for (unsigned int n = 0; n < MATERIAL_SAMPLERS_PER_KIND; n++)
+                mesh.samplers[kind][n] = Location(MaterialSamplerName(kind) + std::to_string(n + 1));
+        }
+        mesh.diffuseArray = GetUniform<int>("diffuseArray");
+        mesh.specularArray = GetUniform<int>("specularArray");
+        mesh.diffuseLayer = GetUniform<int>("diffuseLayer");
+        mesh.specularLayer = GetUniform<int>("specularLayer");
+        mesh.quantizedPositions = GetUniform<bool>("quantizedPositions");
+        mesh.positionScale = GetUniform<glm::vec3>("positionScale");
+        mesh.positionOffset = GetUniform<glm::vec3>("positionOffset");
+        mesh.model = GetUniform<glm::mat4>("model");
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
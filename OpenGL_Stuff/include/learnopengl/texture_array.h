@@ -0,0 +1,250 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// texture units the arrays are bound to, past the ones Mesh::BindTextures uses for plain 2D textures
+// (a sampler2D and a sampler2DArray can't share a unit)
+const unsigned int TEXTURE_ARRAY_UNIT_DIFFUSE = 8;
+const unsigned int TEXTURE_ARRAY_UNIT_SPECULAR = 9;
+
+// where a 2D texture ended up inside a TextureArraySet
+struct TextureArrayLayer {
+    unsigned int array = 0;   // GL_TEXTURE_2D_ARRAY object, 0 if the texture wasn't packed
+    int layer = -1;
+
+    bool valid() const { return array != 0; }
+};
+
+// Packs already uploaded 2D textures into GL_TEXTURE_2D_ARRAYs, so meshes whose textures share an
+// array draw one after another with the array bound once and only a layer uniform changing.
+// Textures are grouped by internal format, size and mip count (a layer must match the others
+// exactly); groups of a single texture are left alone. Every level is read back from the GPU and
+// copied into its layer, which works for the block-compressed textures too. The source textures
+// aren't touched here: they are owned by the TextureCache, and Model::PackTextureArrays frees the
+// ones nothing samples as 2D any more once they are packed.
+// The arrays are deleted by clear(), not by the destructor: call it on the GL thread before the
+// context goes away.
+class TextureArraySet
+{
+public:
+    TextureArraySet() {}
+    TextureArraySet(const TextureArraySet &) = delete;
+    TextureArraySet &operator=(const TextureArraySet &) = delete;
+
+    // registers a 2D texture for the next Build(). duplicates are ignored.
+    void Add(unsigned int texture)
+    {
+        if (texture != 0 && std::find(pending.begin(), pending.end(), texture) == pending.end())
+            pending.push_back(texture);
+    }
+
+    // creates an array for every group of two or more compatible textures added since the last Build().
+    // must run on the GL thread.
+    void Build()
+    {
+        std::map<std::tuple<GLint, GLint, GLint, GLint>, std::vector<unsigned int>> groups;
+        for (size_t i = 0; i < pending.size(); i++)
+        {
+            if (layers.count(pending[i]))
+                continue;
+            GLint format = 0, width = 0, height = 0;
+            glBindTexture(GL_TEXTURE_2D, pending[i]);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+            if (width > 0 && height > 0)
+                groups[std::make_tuple(format, width, height, levelCount(width, height))].push_back(pending[i]);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        pending.clear();
+
+        for (std::map<std::tuple<GLint, GLint, GLint, GLint>, std::vector<unsigned int>>::iterator group = groups.begin(); group != groups.end(); ++group)
+        {
+            if (group->second.size() < 2)
+                continue;
+            buildArray(std::get<0>(group->first), std::get<1>(group->first), std::get<2>(group->first),
+                       std::get<3>(group->first), group->second);
+        }
+    }
+
+    // layer holding 'texture' for one more user, or an invalid one if it isn't in any array. every
+    // valid layer acquired must be given back with Release().
+    TextureArrayLayer Acquire(unsigned int texture)
+    {
+        std::unordered_map<unsigned int, LayerEntry>::iterator found = layers.find(texture);
+        if (found == layers.end())
+            return TextureArrayLayer();
+        found->second.users++;
+        return found->second.layer;
+    }
+
+    // gives back a layer of Acquire(). the layer is dropped with its last user (so a new texture
+    // reusing the GL name doesn't map to it) and an array is deleted once all its layers are
+    // dropped. textures are shared between models, so a model must only release the layers it
+    // acquired, right before it is destroyed. GL thread.
+    void Release(unsigned int texture)
+    {
+        std::unordered_map<unsigned int, LayerEntry>::iterator found = layers.find(texture);
+        if (found == layers.end() || found->second.users == 0 || --found->second.users > 0)
+            return;
+        unsigned int array = found->second.layer.array;
+        layers.erase(found);
+        for (size_t i = 0; i < arrays.size(); i++)
+        {
+            if (arrays[i] != array || --arrayLayers[i] > 0)
+                continue;
+            glDeleteTextures(1, &arrays[i]);
+            bytes -= arrayBytes[i];
+            arrays.erase(arrays.begin() + i);
+            arrayLayers.erase(arrayLayers.begin() + i);
+            arrayBytes.erase(arrayBytes.begin() + i);
+            break;
+        }
+    }
+
+    // layer holding 'texture', or an invalid one if it isn't in any array
+    TextureArrayLayer Find(unsigned int texture) const
+    {
+        std::unordered_map<unsigned int, LayerEntry>::const_iterator found = layers.find(texture);
+        return found != layers.end() ? found->second.layer : TextureArrayLayer();
+    }
+
+    size_t ArrayCount() const { return arrays.size(); }
+    size_t LayerCount() const { return layers.size(); }
+
+    // bytes of VRAM held by the arrays
+    size_t Bytes() const { return bytes; }
+
+    void PrintReport(std::ostream &out) const
+    {
+        out << "TEXTURE_ARRAY:: " << arrays.size() << " arrays, " << layers.size() << " layers, "
+            << std::fixed << std::setprecision(2) << bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+        out.unsetf(std::ios::fixed);
+    }
+
+    // deletes every array. must run on the GL thread.
+    void clear()
+    {
+        if (!arrays.empty())
+            glDeleteTextures((GLsizei)arrays.size(), &arrays[0]);
+        arrays.clear();
+        arrayLayers.clear();
+        arrayBytes.clear();
+        layers.clear();
+        pending.clear();
+        bytes = 0;
+    }
+
+private:
+    struct LayerEntry {
+        TextureArrayLayer layer;
+        unsigned int users = 0;   // Acquire() calls not released yet
+    };
+
+    std::vector<unsigned int> pending;
+    std::vector<unsigned int> arrays;
+    std::vector<unsigned int> arrayLayers;   // layers of each array still in use
+    std::vector<size_t> arrayBytes;
+    std::unordered_map<unsigned int, LayerEntry> layers;   // source texture -> its layer
+    size_t bytes = 0;
+
+    // levels the bound texture really has: its base level up to GL_TEXTURE_MAX_LEVEL, capped by the full chain
+    static GLint levelCount(GLint width, GLint height)
+    {
+        GLint maxLevel = 1000;
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        GLint fullChain = 1;
+        while ((width | height) > 1)
+        {
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+            fullChain++;
+        }
+        return std::min(maxLevel + 1, fullChain);
+    }
+
+    void buildArray(GLint format, GLint width, GLint height, GLint levels, const std::vector<unsigned int> &textures)
+    {
+        GLsizei count = (GLsizei)textures.size();
+        size_t totalBytes = 0;
+        GLint compressed = GL_FALSE;
+        glBindTexture(GL_TEXTURE_2D, textures[0]);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+
+        unsigned int array;
+        glGenTextures(1, &array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        std::vector<unsigned char> pixels;
+        for (GLint level = 0; level < levels; level++)
+        {
+            GLint w = std::max(1, width >> level), h = std::max(1, height >> level);
+            GLint levelBytes = w * h * 4;
+            if (compressed)
+            {
+                glBindTexture(GL_TEXTURE_2D, textures[0]);
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &levelBytes);
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, w, h, count, 0, levelBytes * count, NULL);
+            }
+            else
+            {
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, w, h, count, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            }
+            pixels.resize(levelBytes);
+
+            // each layer is read back and written at its index
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (GLsizei layer = 0; layer < count; layer++)
+            {
+                glBindTexture(GL_TEXTURE_2D, textures[layer]);
+                if (compressed)
+                {
+                    glGetCompressedTexImage(GL_TEXTURE_2D, level, &pixels[0]);
+                    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, format, levelBytes, &pixels[0]);
+                }
+                else
+                {
+                    glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+                }
+            }
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            totalBytes += (size_t)levelBytes * count;
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        // layers keep the channel mapping of their sources (grey + alpha textures are swizzled RG)
+        GLint swizzle[4];
+        glBindTexture(GL_TEXTURE_2D, textures[0]);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        arrays.push_back(array);
+        arrayLayers.push_back((unsigned int)count);
+        arrayBytes.push_back(totalBytes);
+        bytes += totalBytes;
+        for (GLsizei layer = 0; layer < count; layer++)
+        {
+            LayerEntry entry;
+            entry.layer.array = array;
+            entry.layer.layer = layer;
+            layers[textures[layer]] = entry;
+        }
+    }
+};
+#endif
@@ -0,0 +1,416 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/load_profiler.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#ifndef _WIN32
+#include <climits>
+#include <unistd.h>
+#endif
+
+// Process-wide cache of GL textures loaded from files, shared by every Model.
+// Entries are keyed by the content of the image (ContentKey), so byte-identical files under
+// different paths or names - model folders shipping the same texture set - decode and upload once.
+// They are reference counted: each Model acquires the textures it uses and releases them when it
+// is destroyed; the GL texture is deleted when the last user lets go of it.
+class TextureCache
+{
+public:
+    struct Stats {
+        unsigned int textures = 0;    // live entries
+        size_t       bytes = 0;       // estimated VRAM of the live entries, mip chain included
+        unsigned int hits = 0;        // requests served without decoding
+        unsigned int misses = 0;      // requests that had to decode and upload
+        unsigned int contentHits = 0; // hits for a file other than the one the texture was loaded from
+    };
+
+    // what content keys saved, over the live entries
+    struct DedupStats {
+        unsigned int textures = 0;    // entries shared by files with different paths
+        unsigned int duplicates = 0;  // files served by another file's texture
+        size_t       bytes = 0;       // VRAM the duplicates would have taken
+        double       seconds = 0.0;   // decode, compression and upload time they didn't repeat
+    };
+
+    static TextureCache &Instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    // absolute path with '/' separators and "." / ".." segments folded, so every spelling of the
+    // same file maps to one key. windows paths are case insensitive, so they are lowercased too.
+    static std::string NormalizePath(const std::string &path)
+    {
+        std::string absolute = path;
+#ifdef _WIN32
+        char buffer[4096];
+        if (_fullpath(buffer, path.c_str(), sizeof(buffer)))
+            absolute = buffer;
+#else
+        if (path.empty() || path[0] != '/')
+        {
+            char buffer[PATH_MAX];
+            if (getcwd(buffer, sizeof(buffer)))
+                absolute = std::string(buffer) + '/' + path;
+        }
+#endif
+        std::vector<std::string> parts;
+        std::string part;
+        for (size_t i = 0; i <= absolute.size(); i++)
+        {
+            char c = i < absolute.size() ? absolute[i] : '/';
+            if (c == '/' || c == '\\')
+            {
+                if (part == "..")
+                {
+                    if (!parts.empty())
+                        parts.pop_back();
+                }
+                else if (!part.empty() && part != ".")
+                    parts.push_back(part);
+                part.clear();
+            }
+            else
+            {
+#ifdef _WIN32
+                c = (char)tolower((unsigned char)c);
+#endif
+                part += c;
+            }
+        }
+
+        std::string normalized;
+#ifdef _WIN32
+        for (size_t i = 0; i < parts.size(); i++)
+            normalized += (i ? "/" : "") + parts[i];
+#else
+        for (size_t i = 0; i < parts.size(); i++)
+            normalized += "/" + parts[i];
+#endif
+        return normalized;
+    }
+
+    // the cache key of an image file: a hash of its bytes (and size), or its normalized path if it
+    // can't be read. hashes are remembered per path and file stamp, so a file is only read for this
+    // once; LoadContentHashes / SaveContentHashes keep them between runs. safe from any thread.
+    std::string ContentKey(const std::string &path)
+    {
+        std::string normalized = NormalizePath(path);
+        FileStamp stamp;
+        if (!GetAssetStamp(path, stamp))
+            return normalized;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::unordered_map<std::string, ContentHash>::const_iterator known = contentHashes.find(normalized);
+            if (known != contentHashes.end() && known->second.stamp == stamp)
+                return contentKey(known->second);
+        }
+
+        AssetFile file(path);
+        if (!file.isOpen())
+            return normalized;
+        ContentHash hash;
+        hash.stamp = stamp;
+        {
+            LoadTimer timer(path, LOAD_STAGE_FILE_READ, file.size());
+            hash.hash = HashBytes(file.data(), file.size());
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        contentHashes[normalized] = hash;
+        hashesChanged = true;
+        return contentKey(hash);
+    }
+
+    // 64-bit hash of a block of memory, eight bytes at a time
+    static uint64_t HashBytes(const unsigned char *data, size_t size)
+    {
+        uint64_t hash = 14695981039346656037ULL ^ size;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, data + i, 8);
+            hash = (hash ^ word) * 1099511628211ULL;
+            hash ^= hash >> 32;
+        }
+        for (; i < size; i++)
+            hash = (hash ^ data[i]) * 1099511628211ULL;
+        // final avalanche (MurmurHash3 fmix64)
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    // reads the content hashes a previous run saved. entries whose file changed are recomputed.
+    bool LoadContentHashes(const std::string &path)
+    {
+        std::ifstream in(path.c_str());
+        if (!in)
+            return false;
+        std::lock_guard<std::mutex> lock(mutex);
+        ContentHash hash;
+        std::string file;
+        while (in >> std::hex >> hash.hash >> std::dec >> hash.stamp.size >> hash.stamp.mtime && std::getline(in >> std::ws, file))
+            contentHashes[file] = hash;
+        return true;
+    }
+
+    // writes the known content hashes, if any were computed since they were loaded
+    bool SaveContentHashes(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!hashesChanged)
+            return true;
+        std::ofstream out(path.c_str(), std::ios::trunc);
+        if (!out)
+            return false;
+        for (std::unordered_map<std::string, ContentHash>::const_iterator it = contentHashes.begin(); it != contentHashes.end(); ++it)
+            out << std::hex << it->second.hash << std::dec << ' ' << it->second.stamp.size << ' ' << it->second.stamp.mtime << ' ' << it->first << '\n';
+        hashesChanged = false;
+        return (bool)out;
+    }
+
+    // takes a reference on 'key'. returns true if the texture already exists (or is being loaded by
+    // someone else) and stores its id in 'id'; returns false if the caller created the entry and must
+    // load the texture and hand it over with Store(). 'source' is the file the caller wants, for the
+    // deduplication report.
+    bool Acquire(const std::string &key, unsigned int &id, const std::string &source = std::string())
+    {
+        std::string sourceKey = source.empty() ? std::string() : NormalizePath(source);
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry &entry = entries[key];
+        entry.refCount++;
+        if (entry.refCount > 1)
+        {
+            id = entry.id;
+            stats.hits++;
+            noteAlias(entry, sourceKey);
+            return true;
+        }
+        id = 0;
+        stats.misses++;
+        entry.source = source;
+        entry.sourceKey = sourceKey;
+        return false;
+    }
+
+    // attaches the GL texture created for 'key' after a missed Acquire().
+    void Store(const std::string &key, unsigned int id, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unordered_map<std::string, Entry>::iterator it = entries.find(key);
+        if (it == entries.end())
+            return;
+        it->second.id = id;
+        it->second.bytes = bytes;
+    }
+
+    // id of a cached texture, 0 if it is unknown or still being loaded
+    unsigned int Find(const std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unordered_map<std::string, Entry>::const_iterator it = entries.find(key);
+        return it == entries.end() ? 0 : it->second.id;
+    }
+
+    // size and number of users of a cached texture. returns false if 'key' isn't cached.
+    bool Lookup(const std::string &key, size_t &bytes, unsigned int &users)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unordered_map<std::string, Entry>::const_iterator it = entries.find(key);
+        if (it == entries.end())
+            return false;
+        bytes = it->second.bytes;
+        users = it->second.refCount;
+        return true;
+    }
+
+    // drops a reference; the GL texture is deleted with the last one. must run on the GL thread.
+    void Release(const std::string &key)
+    {
+        unsigned int id = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::unordered_map<std::string, Entry>::iterator it = entries.find(key);
+            if (it == entries.end())
+                return;
+            if (--it->second.refCount > 0)
+                return;
+            id = it->second.id;
+            entries.erase(it);
+        }
+        if (id != 0)
+            glDeleteTextures(1, &id);
+    }
+
+    // deletes the GL texture of 'key' but keeps the entry and its users: for a texture whose pixels
+    // now live in a texture array and that nothing samples as a 2D texture any more. whoever asks for
+    // it afterwards gets id 0 and uploads it again. must run on the GL thread.
+    void DropTexture(const std::string &key)
+    {
+        unsigned int id = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::unordered_map<std::string, Entry>::iterator it = entries.find(key);
+            if (it == entries.end())
+                return;
+            id = it->second.id;
+            it->second.id = 0;
+            it->second.bytes = 0;
+        }
+        if (id != 0)
+            glDeleteTextures(1, &id);
+    }
+
+    // records that 'source' uses the texture of 'key' too, without taking a reference (a Model
+    // that reaches the same content under two paths holds one reference)
+    void AddAlias(const std::string &key, const std::string &source)
+    {
+        std::string sourceKey = NormalizePath(source);
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unordered_map<std::string, Entry>::iterator it = entries.find(key);
+        if (it != entries.end())
+            noteAlias(it->second, sourceKey);
+    }
+
+    Stats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Stats result = stats;
+        result.textures = (unsigned int)entries.size();
+        result.bytes = 0;
+        for (std::unordered_map<std::string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+            result.bytes += it->second.bytes;
+        return result;
+    }
+
+    DedupStats GetDedupStats()
+    {
+        std::vector<Shared> shared = sharedEntries();
+        DedupStats result;
+        for (size_t i = 0; i < shared.size(); i++)
+        {
+            result.textures++;
+            result.duplicates += (unsigned int)shared[i].aliases.size();
+            result.bytes += shared[i].bytes * shared[i].aliases.size();
+            result.seconds += sourceSeconds(shared[i].source) * shared[i].aliases.size();
+        }
+        return result;
+    }
+
+    // the textures several files share, with what that saved
+    void PrintDedupReport(std::ostream &out)
+    {
+        std::vector<Shared> shared = sharedEntries();
+        DedupStats totals = GetDedupStats();
+        out << "TEXTURE_CACHE:: " << totals.duplicates << " duplicate files share " << totals.textures << " textures, saved "
+            << std::fixed << std::setprecision(2) << totals.bytes / (1024.0 * 1024.0) << " MB VRAM and "
+            << totals.seconds * 1000.0 << " ms" << std::endl;
+        for (size_t i = 0; i < shared.size(); i++)
+        {
+            out << "  " << shared[i].source << " (" << shared[i].bytes / (1024.0 * 1024.0) << " MB) also used for:" << std::endl;
+            for (size_t a = 0; a < shared[i].aliases.size(); a++)
+                out << "    " << shared[i].aliases[a] << std::endl;
+        }
+        out.unsetf(std::ios::fixed);
+        out << std::setprecision(6);
+    }
+
+private:
+    struct Entry {
+        unsigned int id = 0;
+        unsigned int refCount = 0;
+        size_t       bytes = 0;
+        std::string  source;                 // file the texture was loaded from, as the loader named it
+        std::string  sourceKey;              // the same, normalized
+        std::vector<std::string> aliases;    // other files (normalized) with the same content
+    };
+
+    struct ContentHash {
+        FileStamp stamp;
+        uint64_t  hash = 0;
+    };
+
+    // an entry with aliases, copied out of the lock
+    struct Shared {
+        std::string source;
+        size_t bytes;
+        std::vector<std::string> aliases;
+    };
+
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<std::string, ContentHash> contentHashes;   // by normalized path
+    bool hashesChanged = false;
+    std::mutex mutex;
+    Stats stats;
+
+    void noteAlias(Entry &entry, const std::string &sourceKey)
+    {
+        if (sourceKey.empty() || sourceKey == entry.sourceKey)
+            return;
+        stats.contentHits++;
+        if (std::find(entry.aliases.begin(), entry.aliases.end(), sourceKey) == entry.aliases.end())
+            entry.aliases.push_back(sourceKey);
+    }
+
+    static std::string contentKey(const ContentHash &hash)
+    {
+        std::ostringstream key;
+        key << "content:" << std::hex << std::setw(16) << std::setfill('0') << hash.hash << ':' << std::dec << hash.stamp.size;
+        return key.str();
+    }
+
+    std::vector<Shared> sharedEntries()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Shared> shared;
+        for (std::unordered_map<std::string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+        {
+            if (it->second.aliases.empty())
+                continue;
+            Shared entry;
+            entry.source = it->second.source;
+            entry.bytes = it->second.bytes;
+            entry.aliases = it->second.aliases;
+            shared.push_back(entry);
+        }
+        std::sort(shared.begin(), shared.end(), [](const Shared &a, const Shared &b) { return a.source < b.source; });
+        return shared;
+    }
+
+    // what loading 'source' cost in the LoadProfiler, past reading and hashing the file
+    static double sourceSeconds(const std::string &source)
+    {
+        std::vector<LoadProfiler::AssetStats> assets = LoadProfiler::Instance().Assets();
+        for (size_t i = 0; i < assets.size(); i++)
+        {
+            if (assets[i].name != source)
+                continue;
+            return assets[i].stages[LOAD_STAGE_IMAGE_DECODE].seconds + assets[i].stages[LOAD_STAGE_TEXTURE_COMPRESSION].seconds +
+                   assets[i].stages[LOAD_STAGE_GL_UPLOAD].seconds + assets[i].stages[LOAD_STAGE_MIP_GENERATION].seconds;
+        }
+        return 0.0;
+    }
+
+    TextureCache() {}
+};
+#endif
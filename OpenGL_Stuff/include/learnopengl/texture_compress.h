@@ -0,0 +1,498 @@
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/load_profiler.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/texture_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Block compression of model textures, done once and cached on disk.
+// The first time a texture is loaded it is decoded, its mip chain is built on the CPU and every
+// level is encoded to a BC format; the result is written next to the image as "<image>.dds"
+// (standard DDS, FourCC DXT1/DXT5/ATI1/ATI2) and uploaded with glCompressedTexImage2D. Later runs
+// read the DDS directly while its recorded source size/mtime and encoder version still match.
+//   2 or 4 channels with transparency  -> BC3 (DXT5)   16 bytes / 4x4 block
+//   2, 3 or 4 channels, opaque         -> BC1 (DXT1)    8 bytes / 4x4 block
+//   1 channel                          -> BC4 (RGTC1)   8 bytes / 4x4 block
+// grey + alpha images are expanded to RGBA first, so they sample as luminance / alpha rather than
+// red / green.
+
+// Any change to the encoder, the format choice or the channel mapping must bump this, so DDS files
+// cached by an older build are encoded again.
+const uint32_t TEXTURE_CACHE_VERSION = 2;
+
+// S3TC isn't core in 3.3, so glad doesn't define its enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// switched on by EnableTextureCompression(); read by the loader threads
+inline std::atomic<bool> &TextureCompressionFlag()
+{
+    static std::atomic<bool> enabled(false);
+    return enabled;
+}
+
+inline bool TextureCompressionEnabled()
+{
+    return TextureCompressionFlag().load();
+}
+
+// turns compression on if the driver exposes S3TC (RGTC is core). call on the GL thread once the
+// context exists, before loading models. returns whether compression is now enabled.
+inline bool EnableTextureCompression()
+{
+    bool s3tc = false;
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count && !s3tc; i++)
+    {
+        const char *name = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        s3tc = name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0;
+    }
+    TextureCompressionFlag().store(s3tc);
+    return s3tc;
+}
+
+// bytes of one 4x4 block
+inline size_t CompressedBlockBytes(unsigned int format)
+{
+    return (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RED_RGTC1) ? 8 : 16;
+}
+
+inline size_t CompressedLevelBytes(unsigned int format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * CompressedBlockBytes(format);
+}
+
+namespace texture_compress_detail
+{
+    inline uint16_t packColor565(const float c[3])
+    {
+        int r = (int)(c[0] * 31.0f / 255.0f + 0.5f), g = (int)(c[1] * 63.0f / 255.0f + 0.5f), b = (int)(c[2] * 31.0f / 255.0f + 0.5f);
+        r = std::min(std::max(r, 0), 31); g = std::min(std::max(g, 0), 63); b = std::min(std::max(b, 0), 31);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    inline void unpackColor565(uint16_t c, float out[3])
+    {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        out[0] = (float)((r << 3) | (r >> 2));
+        out[1] = (float)((g << 2) | (g >> 4));
+        out[2] = (float)((b << 3) | (b >> 2));
+    }
+
+    // BC1 colour block of 16 RGBA pixels, always in 4-colour mode (valid inside BC3 too).
+    // endpoints come from the principal axis of the block's colours, inset a little.
+    inline void encodeColorBlock(const unsigned char *rgba, unsigned char *out)
+    {
+        float mean[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+                mean[c] += rgba[i * 4 + c] / 16.0f;
+        float cov[6] = { 0, 0, 0, 0, 0, 0 };
+        for (int i = 0; i < 16; i++)
+        {
+            float d[3] = { rgba[i * 4] - mean[0], rgba[i * 4 + 1] - mean[1], rgba[i * 4 + 2] - mean[2] };
+            cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+            cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+        }
+        // power iteration for the dominant eigenvector
+        float axis[3] = { 1, 1, 1 };
+        for (int it = 0; it < 8; it++)
+        {
+            float next[3] = { cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                              cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                              cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+            float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+            if (length < 1e-6f)
+                break;
+            for (int c = 0; c < 3; c++)
+                axis[c] = next[c] / length;
+        }
+
+        float minT = 1e30f, maxT = -1e30f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = 0;
+            for (int c = 0; c < 3; c++)
+                t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+        float inset = (maxT - minT) / 16.0f;
+        minT += inset;
+        maxT -= inset;
+        float high[3], low[3];
+        for (int c = 0; c < 3; c++)
+        {
+            high[c] = std::min(std::max(mean[c] + axis[c] * maxT, 0.0f), 255.0f);
+            low[c] = std::min(std::max(mean[c] + axis[c] * minT, 0.0f), 255.0f);
+        }
+        uint16_t c0 = packColor565(high), c1 = packColor565(low);
+        if (c0 < c1)
+            std::swap(c0, c1);
+
+        uint32_t indices = 0;
+        if (c0 != c1)
+        {
+            float palette[4][3];
+            unpackColor565(c0, palette[0]);
+            unpackColor565(c1, palette[1]);
+            for (int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+                palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0;
+                float bestDistance = 1e30f;
+                for (int p = 0; p < 4; p++)
+                {
+                    float distance = 0;
+                    for (int c = 0; c < 3; c++)
+                        distance += (rgba[i * 4 + c] - palette[p][c]) * (rgba[i * 4 + c] - palette[p][c]);
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= (uint32_t)best << (i * 2);
+            }
+        }
+        out[0] = (unsigned char)(c0 & 0xFF); out[1] = (unsigned char)(c0 >> 8);
+        out[2] = (unsigned char)(c1 & 0xFF); out[3] = (unsigned char)(c1 >> 8);
+        for (int b = 0; b < 4; b++)
+            out[4 + b] = (unsigned char)(indices >> (b * 8));
+    }
+
+    // BC4 block of 16 single channel values (BC3 alpha, BC4, each half of BC5), 8-value mode
+    inline void encodeChannelBlock(const unsigned char *values, int stride, unsigned char *out)
+    {
+        int low = 255, high = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            low = std::min(low, (int)values[i * stride]);
+            high = std::max(high, (int)values[i * stride]);
+        }
+        out[0] = (unsigned char)high;
+        out[1] = (unsigned char)low;
+        uint64_t indices = 0;
+        if (high != low)
+        {
+            int palette[8] = { high, low };
+            for (int p = 1; p < 7; p++)
+                palette[p + 1] = ((7 - p) * high + p * low) / 7;
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0, bestDistance = 256;
+                for (int p = 0; p < 8; p++)
+                {
+                    int distance = std::abs((int)values[i * stride] - palette[p]);
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        best = p;
+                    }
+                }
+                indices |= (uint64_t)best << (i * 3);
+            }
+        }
+        for (int b = 0; b < 6; b++)
+            out[2 + b] = (unsigned char)(indices >> (b * 8));
+    }
+
+    // encodes one level stored as RGBA8
+    inline void encodeLevel(const std::vector<unsigned char> &rgba, int width, int height, unsigned int format, unsigned char *out)
+    {
+        unsigned char block[16 * 4];
+        for (int by = 0; by < height; by += 4)
+            for (int bx = 0; bx < width; bx += 4)
+            {
+                // blocks hanging over the edge repeat the last row/column
+                for (int y = 0; y < 4; y++)
+                    for (int x = 0; x < 4; x++)
+                    {
+                        int sx = std::min(bx + x, width - 1), sy = std::min(by + y, height - 1);
+                        memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+                    }
+                if (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+                {
+                    encodeColorBlock(block, out);
+                    out += 8;
+                }
+                else if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+                {
+                    encodeChannelBlock(block + 3, 4, out);
+                    encodeColorBlock(block, out + 8);
+                    out += 16;
+                }
+                else
+                {
+                    encodeChannelBlock(block, 4, out);
+                    out += 8;
+                }
+            }
+    }
+
+    // next mip level with a 2x2 box filter (odd sizes clamp at the edge)
+    inline std::vector<unsigned char> downsample(const std::vector<unsigned char> &rgba, int width, int height)
+    {
+        int w = std::max(1, width / 2), h = std::max(1, height / 2);
+        std::vector<unsigned char> result((size_t)w * h * 4);
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++)
+            {
+                int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+                for (int c = 0; c < 4; c++)
+                {
+                    int sum = rgba[((size_t)y0 * width + x0) * 4 + c] + rgba[((size_t)y0 * width + x1) * 4 + c] +
+                              rgba[((size_t)y1 * width + x0) * 4 + c] + rgba[((size_t)y1 * width + x1) * 4 + c];
+                    result[((size_t)y * w + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        return result;
+    }
+
+    // DDS header, as 31 little endian dwords after the "DDS " magic
+    const uint32_t DDS_MAGIC = 0x20534444;           // "DDS "
+    const uint32_t DDS_SOURCE_MARK = 0x4C474F4C;     // "LOGL", our stamp in dwReserved1, followed by the source stamp and TEXTURE_CACHE_VERSION
+    const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000;
+    const uint32_t DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+
+    inline uint32_t fourCC(const char *code)
+    {
+        return (uint32_t)code[0] | ((uint32_t)code[1] << 8) | ((uint32_t)code[2] << 16) | ((uint32_t)code[3] << 24);
+    }
+
+    inline uint32_t formatFourCC(unsigned int format)
+    {
+        switch (format)
+        {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:  return fourCC("DXT1");
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return fourCC("DXT5");
+        case GL_COMPRESSED_RED_RGTC1:          return fourCC("ATI1");
+        default:                               return fourCC("ATI2");
+        }
+    }
+
+    inline unsigned int fourCCFormat(uint32_t code)
+    {
+        if (code == fourCC("DXT1")) return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        if (code == fourCC("DXT5")) return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        if (code == fourCC("ATI1") || code == fourCC("BC4U")) return GL_COMPRESSED_RED_RGTC1;
+        if (code == fourCC("ATI2") || code == fourCC("BC5U")) return GL_COMPRESSED_RG_RGTC2;
+        return 0;
+    }
+}
+
+// replaces the pixels of 'image' by a block-compressed full mip chain
+inline void CompressImage(DecodedImage &image)
+{
+    using namespace texture_compress_detail;
+    if (!image.data || image.width <= 0 || image.height <= 0)
+        return;
+
+    // expand to RGBA8 so every format reads the same layout
+    size_t pixelCount = (size_t)image.width * image.height;
+    std::vector<unsigned char> rgba(pixelCount * 4, 255);
+    bool transparent = false;
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        const unsigned char *src = image.data + i * image.components;
+        unsigned char *dst = &rgba[i * 4];
+        if (image.components == 1)
+        {
+            dst[0] = src[0];
+            dst[1] = 0;
+            dst[2] = 0;
+        }
+        else if (image.components == 2)
+        {
+            // grey + alpha
+            dst[0] = dst[1] = dst[2] = src[0];
+            dst[3] = src[1];
+            transparent = transparent || src[1] != 255;
+        }
+        else
+        {
+            memcpy(dst, src, image.components);
+            transparent = transparent || (image.components == 4 && src[3] != 255);
+        }
+    }
+
+    unsigned int format;
+    if (image.components == 1)
+        format = GL_COMPRESSED_RED_RGTC1;
+    else
+        format = transparent ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+    std::vector<unsigned char> blocks;
+    std::vector<size_t> levelSizes;
+    int width = image.width, height = image.height;
+    for (;;)
+    {
+        size_t levelBytes = CompressedLevelBytes(format, width, height);
+        size_t offset = blocks.size();
+        blocks.resize(offset + levelBytes);
+        encodeLevel(rgba, width, height, format, &blocks[offset]);
+        levelSizes.push_back(levelBytes);
+        if (width == 1 && height == 1)
+            break;
+        rgba = downsample(rgba, width, height);
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+
+    image.reset();
+    image.compressedFormat = format;
+    image.compressed.swap(blocks);
+    image.levelSizes.swap(levelSizes);
+}
+
+// writes a compressed image as DDS, stamped with the source file it came from
+inline bool WriteCompressedTexture(const std::string &path, const DecodedImage &image, const FileStamp &source)
+{
+    using namespace texture_compress_detail;
+    uint32_t header[31];
+    memset(header, 0, sizeof(header));
+    header[0] = 124;
+    header[1] = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header[2] = (uint32_t)image.height;
+    header[3] = (uint32_t)image.width;
+    header[4] = (uint32_t)image.levelSizes[0];
+    header[6] = (uint32_t)image.levelSizes.size();
+    header[7] = DDS_SOURCE_MARK;
+    header[8] = (uint32_t)(source.size & 0xFFFFFFFFu);
+    header[9] = (uint32_t)(source.size >> 32);
+    header[10] = (uint32_t)((uint64_t)source.mtime & 0xFFFFFFFFu);
+    header[11] = (uint32_t)((uint64_t)source.mtime >> 32);
+    header[12] = TEXTURE_CACHE_VERSION;
+    header[18] = 32;
+    header[19] = DDPF_FOURCC;
+    header[20] = formatFourCC(image.compressedFormat);
+    header[26] = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cout << "WARNING::TEXTURE_COMPRESS:: could not write " << tempPath << std::endl;
+            return false;
+        }
+        uint32_t magic = DDS_MAGIC;
+        out.write((const char *)&magic, sizeof(magic));
+        out.write((const char *)header, sizeof(header));
+        out.write((const char *)&image.compressed[0], (std::streamsize)image.compressed.size());
+        if (!out)
+        {
+            out.close();
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+    remove(path.c_str());
+    if (rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// reads a DDS written by WriteCompressedTexture. fails if it was made from a different version of the
+// source or by another version of the encoder.
+inline bool ReadCompressedTexture(const std::string &path, const FileStamp &source, DecodedImage &image)
+{
+    using namespace texture_compress_detail;
+    MappedFile file;
+    if (!file.open(path) || file.size() < 4 + 124)
+        return false;
+    uint32_t header[31];
+    memcpy(header, file.data() + 4, sizeof(header));
+    uint64_t size = (uint64_t)header[8] | ((uint64_t)header[9] << 32);
+    int64_t mtime = (int64_t)((uint64_t)header[10] | ((uint64_t)header[11] << 32));
+    unsigned int format = fourCCFormat(header[20]);
+    if (*(const uint32_t *)file.data() != DDS_MAGIC || header[0] != 124 || header[7] != DDS_SOURCE_MARK ||
+        header[12] != TEXTURE_CACHE_VERSION ||
+        size != source.size || mtime != source.mtime || format == 0 || header[2] == 0 || header[3] == 0)
+        return false;
+
+    int width = (int)header[3], height = (int)header[2];
+    unsigned int levels = std::max(1u, header[6]);
+    std::vector<size_t> levelSizes;
+    size_t total = 0;
+    for (unsigned int level = 0; level < levels; level++)
+    {
+        levelSizes.push_back(CompressedLevelBytes(format, width, height));
+        total += levelSizes.back();
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    if (file.size() < 4 + 124 + total)
+        return false;
+
+    image.reset();
+    image.path = path;
+    image.width = (int)header[3];
+    image.height = (int)header[2];
+    image.compressedFormat = format;
+    image.compressed.assign(file.data() + 4 + 124, file.data() + 4 + 124 + total);
+    image.levelSizes.swap(levelSizes);
+    return true;
+}
+
+// what the decode pool runs for model textures: the cached DDS if it is up to date, otherwise the
+// image is decoded, compressed and cached. without compression it is a plain DecodeImageFile().
+inline DecodedImage LoadTextureImage(const std::string &filename)
+{
+    if (!TextureCompressionEnabled())
+        return DecodeImageFile(filename);
+
+    FileStamp source;
+    if (!GetAssetStamp(filename, source))
+        return DecodeImageFile(filename);
+    std::string cachePath = filename + ".dds";
+    DecodedImage image;
+    {
+        LoadTimer timer(filename, LOAD_STAGE_FILE_READ);
+        if (ReadCompressedTexture(cachePath, source, image))
+        {
+            timer.AddBytes(image.byteSize());
+            image.path = filename;
+            return image;
+        }
+    }
+
+    image = DecodeImageFile(filename);
+    if (!image.data)
+        return image;
+    LoadTimer timer(filename, LOAD_STAGE_TEXTURE_COMPRESSION);
+    CompressImage(image);
+    WriteCompressedTexture(cachePath, image, source);
+    timer.AddBytes(image.byteSize());
+    return image;
+}
+#endif
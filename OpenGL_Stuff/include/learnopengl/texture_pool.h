@@ -0,0 +1,150 @@
+#ifndef TEXTURE_POOL_H
+#define TEXTURE_POOL_H
+
+#include <learnopengl/asset_pack.h>
+#include <learnopengl/load_profiler.h>
+#include <learnopengl/stb_image.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// pixels of an image decoded on the CPU, waiting to be uploaded on the GL thread.
+// owns the stb_image allocation and frees it when destroyed. a block-compressed image (see
+// texture_compress.h) has no 'data'; it carries every mip level in 'compressed' instead.
+struct DecodedImage {
+    std::string path;
+    unsigned char *data = nullptr;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    unsigned int compressedFormat = 0;       // GL_COMPRESSED_* format, 0 for plain pixels
+    std::vector<unsigned char> compressed;   // mip levels back to back, largest first
+    std::vector<size_t> levelSizes;
+
+    DecodedImage() {}
+    DecodedImage(DecodedImage &&other) { *this = std::move(other); }
+    DecodedImage &operator=(DecodedImage &&other)
+    {
+        if (this != &other)
+        {
+            reset();
+            path = std::move(other.path);
+            data = other.data; width = other.width; height = other.height; components = other.components;
+            compressedFormat = other.compressedFormat;
+            compressed = std::move(other.compressed);
+            levelSizes = std::move(other.levelSizes);
+            other.data = nullptr;
+        }
+        return *this;
+    }
+    DecodedImage(const DecodedImage &) = delete;
+    DecodedImage &operator=(const DecodedImage &) = delete;
+    ~DecodedImage() { reset(); }
+
+    void reset()
+    {
+        if (data)
+            stbi_image_free(data);
+        data = nullptr;
+    }
+
+    bool valid() const { return data != nullptr || !compressed.empty(); }
+
+    // bytes the image sends to the GPU, without the mipmaps glGenerateMipmap adds to plain pixels
+    size_t byteSize() const
+    {
+        return compressedFormat ? compressed.size() : (size_t)width * height * components;
+    }
+};
+
+// decodes an image file (loose or in the mounted asset pack) with stb_image. safe to call from any thread.
+inline DecodedImage DecodeImageFile(const std::string &filename)
+{
+    LoadTimer timer(filename, LOAD_STAGE_IMAGE_DECODE);
+    DecodedImage image;
+    image.path = filename;
+    AssetFile file(filename);
+    if (file.isOpen())
+        image.data = stbi_load_from_memory(file.data(), (int)file.size(), &image.width, &image.height, &image.components, 0);
+    timer.AddBytes(image.byteSize());
+    return image;
+}
+
+// Worker threads that decode image files in parallel. Only the decode runs here; the GL upload
+// (glTexImage2D + mipmaps) stays on the thread that owns the context, which waits on the futures.
+class TextureDecodePool
+{
+public:
+    static TextureDecodePool &Instance()
+    {
+        static TextureDecodePool pool;
+        return pool;
+    }
+
+    // queues 'filename' for decoding with 'loader' and returns a future for the decoded pixels
+    std::future<DecodedImage> Submit(const std::string &filename, DecodedImage (*loader)(const std::string &) = DecodeImageFile)
+    {
+        std::shared_ptr<std::promise<DecodedImage>> promise = std::make_shared<std::promise<DecodedImage>>();
+        std::future<DecodedImage> result = promise->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back([promise, filename, loader]() { promise->set_value(loader(filename)); });
+        }
+        wake.notify_one();
+        return result;
+    }
+
+    unsigned int WorkerCount() const { return (unsigned int)workers.size(); }
+
+    ~TextureDecodePool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    TextureDecodePool()
+    {
+        // the GL thread only blocks on the results while the pool works, so every core gets a worker
+        unsigned int count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int i = 0; i < count; i++)
+            workers.push_back(std::thread([this]() { run(); }));
+    }
+
+    void run()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
+#endif
@@ -0,0 +1,365 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/load_profiler.h>
+#include <learnopengl/texture_compress.h>
+#include <learnopengl/texture_pool.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// Pixel buffer objects textures are uploaded through. The pixels are copied into a PBO and
+// glTex(Compressed)SubImage2D reads them from there, so the call returns without the driver copying
+// them or waiting for the GPU. Every buffer is fenced after its transfer and written again only
+// once the fence has signaled; the buffers are used in turn, so only the oldest one needs checking.
+// Map() doesn't wait for it: when all of them are still in flight the upload continues next frame.
+// Created on first use; clear() deletes them on the GL thread before the context goes away.
+class PixelUploadRing
+{
+public:
+    static const size_t BUFFER_BYTES = 4 * 1024 * 1024;
+    static const unsigned int BUFFER_COUNT = 4;
+
+    static PixelUploadRing &Instance()
+    {
+        static PixelUploadRing ring;
+        return ring;
+    }
+
+    PixelUploadRing(const PixelUploadRing &) = delete;
+    PixelUploadRing &operator=(const PixelUploadRing &) = delete;
+
+    // binds the next buffer to GL_PIXEL_UNPACK_BUFFER and maps 'bytes' (at most BUFFER_BYTES) of it
+    // for writing. returns null if its previous transfer hasn't finished, unless 'wait' is set.
+    unsigned char *Map(size_t bytes, bool wait = false)
+    {
+        if (slots.empty())
+            create();
+        Slot &slot = slots[next];
+        if (slot.fence)
+        {
+            GLenum status = glClientWaitSync(slot.fence, 0, 0);
+            while (wait && status == GL_TIMEOUT_EXPIRED)
+                status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+            if (status == GL_TIMEOUT_EXPIRED)
+            {
+                stalls++;
+                return nullptr;
+            }
+            glDeleteSync(slot.fence);
+            slot.fence = 0;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        // the fence says the GPU is done with the buffer, so there is nothing to synchronize
+        void *memory = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)bytes,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!memory)
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return (unsigned char *)memory;
+    }
+
+    // unmaps the buffer Map() returned; it stays bound for the transfer, which reads from offset 0
+    void Unmap()
+    {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    // fences the transfer just issued from the bound buffer, unbinds it and moves to the next one
+    void Fence(size_t bytes)
+    {
+        slots[next].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        next = (next + 1) % slots.size();
+        staged += bytes;
+    }
+
+    // bytes sent through the buffers, and how often an upload had to wait for a free one
+    size_t StagedBytes() const { return staged; }
+    unsigned int Stalls() const { return stalls; }
+
+    void clear()
+    {
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            if (slots[i].fence)
+                glDeleteSync(slots[i].fence);
+            glDeleteBuffers(1, &slots[i].buffer);
+        }
+        slots.clear();
+        next = 0;
+    }
+
+private:
+    struct Slot {
+        unsigned int buffer = 0;
+        GLsync fence = 0;
+    };
+    std::vector<Slot> slots;
+    size_t next = 0;
+    size_t staged = 0;
+    unsigned int stalls = 0;
+
+    PixelUploadRing() {}
+
+    void create()
+    {
+        slots.resize(BUFFER_COUNT);
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            glGenBuffers(1, &slots[i].buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slots[i].buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, BUFFER_BYTES, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+};
+
+// GL format of an uncompressed image with 'components' channels, as stb_image returns it. grey +
+// alpha images are GL_RG: the texture needs SetGreyAlphaSwizzle() to sample like GL_LUMINANCE_ALPHA.
+inline GLenum PlainTextureFormat(int components)
+{
+    switch (components)
+    {
+    case 1:  return GL_RED;
+    case 2:  return GL_RG;
+    case 3:  return GL_RGB;
+    default: return GL_RGBA;
+    }
+}
+
+// makes the GL_RG texture bound to 'target' read as grey, grey, grey, alpha
+inline void SetGreyAlphaSwizzle(GLenum target)
+{
+    GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+    glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+}
+
+// Uploads decoded images into a texture through the PixelUploadRing, a band of rows at a time, so
+// a large texture is spread over several frames instead of stalling one. Start() creates the
+// texture with uninitialized storage; each Step() sends up to a byte budget. Until Done() a
+// mipmapped texture is incomplete and samples as black. GL thread only.
+class TextureUpload
+{
+public:
+    TextureUpload() {}
+    TextureUpload(TextureUpload &&other) = default;
+    TextureUpload &operator=(TextureUpload &&other) = default;
+    TextureUpload(const TextureUpload &) = delete;
+    TextureUpload &operator=(const TextureUpload &) = delete;
+
+    // a 2D texture, mipmapped like TextureFromImage: compressed images bring their mip chain,
+    // plain ones get glGenerateMipmap once the last row is in. returns the texture.
+    unsigned int Start(DecodedImage &&image)
+    {
+        target = GL_TEXTURE_2D;
+        images.clear();
+        images.push_back(std::move(image));
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        const DecodedImage &source = images[0];
+        if (source.compressedFormat)
+        {
+            const unsigned char *level = &source.compressed[0];
+            int width = source.width, height = source.height;
+            for (size_t i = 0; i < source.levelSizes.size(); i++)
+            {
+                glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, source.compressedFormat, width, height, 0, (GLsizei)source.levelSizes[i], NULL);
+                addSurface(GL_TEXTURE_2D, (GLint)i, width, height, level, source.levelSizes[i], source.compressedFormat);
+                level += source.levelSizes[i];
+                width = std::max(1, width / 2);
+                height = std::max(1, height / 2);
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)source.levelSizes.size() - 1);
+        }
+        else if (source.data)
+        {
+            GLenum format = PlainTextureFormat(source.components);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, source.width, source.height, 0, format, GL_UNSIGNED_BYTE, NULL);
+            if (format == GL_RG)
+                SetGreyAlphaSwizzle(GL_TEXTURE_2D);
+            addSurface(GL_TEXTURE_2D, 0, source.width, source.height, source.data, source.byteSize(), format);
+        }
+        else
+        {
+            std::cout << "Texture failed to load at path: " << source.path << std::endl;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if (surfaces.empty())
+            finish();
+        return texture;
+    }
+
+    // a cube map from six faces (+X, -X, +Y, -Y, +Z, -Z), linear and clamped, without mipmaps.
+    // returns the texture.
+    unsigned int StartCubemap(std::vector<DecodedImage> &&faces)
+    {
+        target = GL_TEXTURE_CUBE_MAP;
+        images = std::move(faces);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            const DecodedImage &face = images[i];
+            if (!face.data)
+            {
+                std::cout << "Cubemap failed: " << face.path << std::endl;
+                continue;
+            }
+            GLenum side = GL_TEXTURE_CUBE_MAP_POSITIVE_X + (GLenum)i;
+            GLenum format = PlainTextureFormat(face.components);
+            glTexImage2D(side, 0, format, face.width, face.height, 0, format, GL_UNSIGNED_BYTE, NULL);
+            // the swizzle belongs to the whole cube map, so a grey + alpha face sets it for all of them
+            if (format == GL_RG)
+                SetGreyAlphaSwizzle(GL_TEXTURE_CUBE_MAP);
+            addSurface(side, 0, face.width, face.height, face.data, face.byteSize(), format);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        if (surfaces.empty())
+            finish();
+        return texture;
+    }
+
+    // sends up to 'budget' bytes and returns how many were sent. at least one band goes out, even
+    // with a zero budget, unless every staging buffer is still in flight.
+    size_t Step(size_t budget)
+    {
+        return step(budget, false);
+    }
+
+    // sends everything that's left, waiting for staging buffers when it has to
+    void Finish()
+    {
+        while (!done)
+            step((size_t)-1, true);
+    }
+
+    bool Started() const { return texture != 0; }
+    bool Done() const { return done; }
+    unsigned int Texture() const { return texture; }
+
+    // bytes the upload sends in total, and what has been sent
+    size_t TotalBytes() const { return total; }
+    size_t SentBytes() const { return sent; }
+
+private:
+    // one level (or cube face) and how it splits into rows: pixel rows for plain images,
+    // rows of 4x4 blocks for compressed ones
+    struct Surface {
+        GLenum target;
+        GLint level;
+        GLenum format;
+        int width, height;
+        const unsigned char *pixels;
+        size_t rowBytes;
+        size_t rows;
+    };
+
+    GLenum target = GL_TEXTURE_2D;
+    unsigned int texture = 0;
+    std::vector<DecodedImage> images;
+    std::vector<Surface> surfaces;
+    size_t surface = 0;    // next surface to send
+    size_t nextRow = 0;    // next row within it
+    size_t total = 0;
+    size_t sent = 0;
+    bool done = false;
+
+    bool compressed() const { return target == GL_TEXTURE_2D && images[0].compressedFormat != 0; }
+
+    void addSurface(GLenum side, GLint level, int width, int height, const unsigned char *pixels, size_t bytes, GLenum format)
+    {
+        Surface s;
+        s.target = side;
+        s.level = level;
+        s.format = format;
+        s.width = width;
+        s.height = height;
+        s.pixels = pixels;
+        s.rows = compressed() ? (size_t)(height + 3) / 4 : (size_t)height;
+        s.rowBytes = bytes / s.rows;
+        surfaces.push_back(s);
+        total += bytes;
+    }
+
+    size_t step(size_t budget, bool wait)
+    {
+        if (done)
+            return 0;
+        LoadTimer timer(images[0].path, LOAD_STAGE_GL_UPLOAD);
+        size_t stepBytes = 0;
+        bool first = true;
+        glBindTexture(target, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        while (surface < surfaces.size() && (first || stepBytes < budget))
+        {
+            const Surface &s = surfaces[surface];
+            size_t fit = budget > stepBytes ? (budget - stepBytes) / s.rowBytes : 0;
+            size_t rows = std::min(std::max<size_t>(fit, 1), std::max<size_t>(PixelUploadRing::BUFFER_BYTES / s.rowBytes, 1));
+            rows = std::min(rows, s.rows - nextRow);
+            size_t bytes = rows * s.rowBytes;
+
+            unsigned char *staging = PixelUploadRing::Instance().Map(bytes, wait);
+            if (!staging)
+                break;
+            memcpy(staging, s.pixels + nextRow * s.rowBytes, bytes);
+            PixelUploadRing::Instance().Unmap();
+            if (compressed())
+            {
+                GLint y = (GLint)nextRow * 4;
+                GLsizei height = std::min((GLsizei)rows * 4, (GLsizei)s.height - y);
+                glCompressedTexSubImage2D(s.target, s.level, 0, y, s.width, height, s.format, (GLsizei)bytes, NULL);
+            }
+            else
+            {
+                glTexSubImage2D(s.target, s.level, 0, (GLint)nextRow, s.width, (GLsizei)rows, s.format, GL_UNSIGNED_BYTE, NULL);
+            }
+            PixelUploadRing::Instance().Fence(bytes);
+
+            stepBytes += bytes;
+            nextRow += rows;
+            if (nextRow == s.rows)
+            {
+                surface++;
+                nextRow = 0;
+            }
+            first = false;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(target, 0);
+        sent += stepBytes;
+        timer.AddBytes(stepBytes);
+        if (surface == surfaces.size())
+            finish();
+        return stepBytes;
+    }
+
+    // mipmaps for plain 2D images, then the pixels can go
+    void finish()
+    {
+        if (target == GL_TEXTURE_2D && !images.empty() && images[0].data)
+        {
+            LoadTimer timer(images[0].path, LOAD_STAGE_MIP_GENERATION, images[0].byteSize() / 3);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        images.clear();
+        surfaces.clear();
+        done = true;
+    }
+};
+#endif